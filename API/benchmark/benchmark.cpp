@@ -0,0 +1,418 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "dbscan/hpdbscan.h"
+#include "flycounter.h"
+#include "houghdetector.h"
+#include "sparsemask.h"
+#include "vials.h"
+
+/* Benchmarks of the single stages of the counting pipeline on synthetic racks and optionally on real images. */
+/* Image stages are reported in ns per image pixel, clustering stages in ns per fly pixel (point). */
+
+typedef std::chrono::steady_clock BenchClock;
+
+struct Options
+{
+    int         width;
+    int         height;
+    int         flies;       // per vial
+    int         flySize;     // px, semi-major axis of a fly
+    unsigned    seed;
+    int         repetitions;
+    double      minTime;     // s per repetition
+    std::string images;
+    int         vialSize;    // px, only for real images
+    std::string filter;
+    std::string json;
+
+    /* analysis parameters */
+    int threshold;
+    int epsilon;
+    int minPoints;
+    int pixelsPerFly;
+
+    Options()
+    :
+    width(3000),
+    height(2000),
+    flies(10),
+    flySize(8),
+    seed(1),
+    repetitions(5),
+    minTime(0.2),
+    vialSize(150),
+    threshold(100),
+    epsilon(5),
+    minPoints(32),
+    pixelsPerFly(100)
+    {}
+};
+
+struct Frame
+{
+    std::string name;
+    cv::Mat     image; // RGB like the camera image of the controller
+    int         vialSize;
+};
+
+struct Result
+{
+    std::string name;
+    std::string unit;
+    long        iterations;
+    double      items;        // pixels or points per iteration
+    double      mean;         // ns per iteration
+    double      min;
+    double      max;
+};
+
+/* 4x5 vials on a green screen, the flies are dark ellipses placed uniformly inside the vials */
+static Frame generateRack(const Options& options)
+{
+    static const int ROWS    = 4;
+    static const int COLUMNS = 5;
+    static const int SHRINK  = 6; // px, findVials dilates the green screen
+
+    std::mt19937 random(options.seed);
+    cv::theRNG().state = options.seed;
+
+    Frame frame;
+    std::stringstream name;
+    name << "synthetic_" << options.width << "x" << options.height << "_" << options.flies;
+    frame.name  = name.str();
+    frame.image = cv::Mat(options.height, options.width, CV_8UC3, cv::Scalar(20, 180, 20));
+
+    int cellWidth  = options.width  / COLUMNS;
+    int cellHeight = options.height / ROWS;
+    int radius     = (int)(0.4 * std::min(cellWidth, cellHeight));
+    frame.vialSize = radius - SHRINK;
+
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    for (int row = 0; row < ROWS; ++row)
+    {
+        for (int column = 0; column < COLUMNS; ++column)
+        {
+            cv::Point center(column * cellWidth + cellWidth / 2, row * cellHeight + cellHeight / 2);
+            cv::circle(frame.image, center, radius, cv::Scalar(205, 200, 195), -1);
+
+            int reach = std::max(radius - SHRINK - 2 * options.flySize, 0);
+            for (int fly = 0; fly < options.flies; ++fly)
+            {
+                double distance = reach * std::sqrt(unit(random));
+                double angle    = 2.0 * M_PI * unit(random);
+                cv::Point position = center + cv::Point((int)(distance * std::cos(angle)), (int)(distance * std::sin(angle)));
+                cv::ellipse(frame.image, position, cv::Size(options.flySize, std::max(options.flySize / 2, 1)), 360.0 * unit(random), 0.0, 360.0, cv::Scalar(40, 35, 30), -1);
+            }
+        }
+    }
+
+    // sensor noise
+    cv::Mat noise(frame.image.size(), CV_16SC3);
+    cv::randn(noise, cv::Scalar::all(0), cv::Scalar::all(6));
+    cv::add(frame.image, noise, frame.image, cv::noArray(), CV_8U);
+    return frame;
+}
+
+static std::vector<Frame> loadImages(const Options& options)
+{
+    std::vector<Frame> frames;
+    std::vector<cv::String> paths;
+    cv::glob(options.images + "/*", paths, false);
+    std::sort(paths.begin(), paths.end());
+
+    for (const cv::String& path : paths)
+    {
+        Frame frame;
+        cv::Mat image = cv::imread(path);
+        if (image.empty()) continue;
+
+        cv::cvtColor(image, frame.image, CV_BGR2RGB);
+        frame.name     = path.substr(path.find_last_of('/') + 1);
+        frame.vialSize = options.vialSize;
+        frames.push_back(frame);
+    }
+    return frames;
+}
+
+/* runs the function in batches until the minimum time is reached, once per repetition */
+static Result measure(const std::string& name, const std::string& unit, double items, const Options& options, const std::function<void()>& function)
+{
+    Result result;
+    result.name       = name;
+    result.unit       = unit;
+    result.items      = items;
+    result.iterations = 0;
+    result.mean       = 0.0;
+    result.min        = 0.0;
+    result.max        = 0.0;
+
+    function(); // warm up caches and lazy allocations
+
+    std::vector<double> times;
+    for (int repetition = 0; repetition < options.repetitions; ++repetition)
+    {
+        long   iterations = 0;
+        double elapsed    = 0.0;
+        long   batch      = 1;
+        while (elapsed < options.minTime)
+        {
+            BenchClock::time_point start = BenchClock::now();
+            for (long i = 0; i < batch; ++i)
+            {
+                function();
+            }
+            elapsed    += std::chrono::duration<double>(BenchClock::now() - start).count();
+            iterations += batch;
+            batch      *= 2;
+        }
+        times.push_back(elapsed * 1e9 / iterations);
+        result.iterations += iterations;
+    }
+
+    for (double time : times)
+    {
+        result.mean += time / times.size();
+    }
+    result.min = *std::min_element(times.begin(), times.end());
+    result.max = *std::max_element(times.begin(), times.end());
+    return result;
+}
+
+static bool selected(const Options& options, const std::string& name)
+{
+    return options.filter.empty() || name.find(options.filter) != std::string::npos;
+}
+
+static void benchmarkFrame(const Frame& frame, const Options& options, std::vector<Result>& results)
+{
+    FlyCounter counter;
+    counter.setThreshold(options.threshold);
+    counter.setEpsilon(options.epsilon);
+    counter.setMinPoints(options.minPoints);
+    counter.setPixelsPerFly(options.pixelsPerFly);
+
+    const double pixels = (double)frame.image.total();
+    Vials   vials  = findVials(frame.image, frame.vialSize);
+    cv::Mat thresh = counter.generateThresholdImage(frame.image, vials);
+    int     flies  = counter.countFlies(thresh, vials);
+
+    double points = 0.0;
+    for (const Vial& vial : vials)
+    {
+        points += vial.flyPixels.rows;
+    }
+    std::cerr << frame.name << ": " << vials.size() << " vials, " << (long)points << " fly pixels, " << flies << " flies" << std::endl;
+
+    auto run = [&](const std::string& stage, const std::string& unit, double items, const std::function<void()>& function)
+    {
+        std::string name = stage + "/" + frame.name;
+        if (!selected(options, name)) return;
+        results.push_back(measure(name, unit, items, options, function));
+
+        const Result& result = results.back();
+        std::cout << std::left  << std::setw(56) << result.name
+                  << std::right << std::setw(14) << std::fixed << std::setprecision(0) << result.mean << " ns"
+                  << std::setw(12) << std::setprecision(3) << result.mean / std::max(result.items, 1.0) << " ns/" << result.unit
+                  << std::setw(10) << result.iterations << std::endl;
+    };
+
+    run("findVials", "pixel", pixels, [&]()
+    {
+        findVials(frame.image, frame.vialSize);
+    });
+    HoughDetector hough;
+    run("HoughDetector::detect", "pixel", pixels, [&]()
+    {
+        hough.detect(frame.image, frame.vialSize);
+    });
+    run("generateThresholdImage", "pixel", pixels, [&]()
+    {
+        counter.generateThresholdImage(frame.image, vials);
+    });
+    run("thresholdVials", "pixel", pixels, [&]()
+    {
+        counter.thresholdVials(frame.image, vials);
+    });
+    run("countFlies", "point", points, [&]()
+    {
+        counter.countFlies(thresh, vials);
+    });
+    run("countFlies/runs", "point", points, [&]()
+    {
+        counter.countFlies(vials);
+    });
+    run("generateClusterImage", "pixel", pixels, [&]()
+    {
+        counter.generateClusterImage(frame.image, vials);
+    });
+    ClusterRenderer renderer;
+    run("ClusterRenderer::render", "pixel", pixels, [&]()
+    {
+        renderer.render(vials, frame.image.size());
+    });
+
+    // the clustering engines alone, per vial like countFlies
+    std::vector<std::vector<Cluster>> labels(vials.size());
+    for (size_t i = 0; i < vials.size(); ++i)
+    {
+        labels[i].resize(vials[i].flyPixels.rows);
+    }
+    run("HPDBSCAN::scan", "point", points, [&]()
+    {
+        for (size_t i = 0; i < vials.size(); ++i)
+        {
+            HPDBSCAN dbscan((float*)vials[i].flyPixels.data, vials[i].flyPixels.rows, 2);
+            dbscan.scan(options.epsilon, options.minPoints, labels[i].data());
+        }
+    });
+    run("RunDBSCAN::scan", "point", points, [&]()
+    {
+        for (size_t i = 0; i < vials.size(); ++i)
+        {
+            RunDBSCAN dbscan(vials[i].runs.data(), vials[i].runs.size());
+            dbscan.scan(options.epsilon, options.minPoints, labels[i].data());
+        }
+    });
+
+    // phase breakdown of one pass of each engine over all vials
+    ScanStats hpdbscan, rundbscan;
+    for (size_t i = 0; i < vials.size(); ++i)
+    {
+        HPDBSCAN((float*)vials[i].flyPixels.data, vials[i].flyPixels.rows, 2).scan(options.epsilon, options.minPoints, labels[i].data(), &hpdbscan);
+        RunDBSCAN(vials[i].runs.data(), vials[i].runs.size()).scan(options.epsilon, options.minPoints, labels[i].data(), &rundbscan);
+    }
+    std::cerr << std::fixed << std::setprecision(3)
+              << frame.name << ": HPDBSCAN space " << hpdbscan.index << " ms, local " << hpdbscan.local << " ms, rules " << hpdbscan.merge << " ms, sort " << hpdbscan.label << " ms" << std::endl
+              << frame.name << ": RunDBSCAN cores " << rundbscan.local << " ms, segments " << rundbscan.index << " ms, union " << rundbscan.merge << " ms, labels " << rundbscan.label << " ms" << std::endl;
+}
+
+/* same layout as the JSON output of Google Benchmark, compare two runs with tools/comparebench.py */
+static bool writeJSON(const std::string& path, const Options& options, const std::vector<Result>& results)
+{
+    std::ofstream file(path);
+    if (!file.good()) return false;
+
+    file << "{\n  \"context\": {\n"
+         << "    \"executable\": \"flyBenchmark\",\n"
+         << "    \"width\": " << options.width << ",\n"
+         << "    \"height\": " << options.height << ",\n"
+         << "    \"flies_per_vial\": " << options.flies << ",\n"
+         << "    \"fly_size\": " << options.flySize << ",\n"
+         << "    \"seed\": " << options.seed << ",\n"
+         << "    \"images\": \"" << options.images << "\",\n"
+         << "    \"threshold\": " << options.threshold << ",\n"
+         << "    \"epsilon\": " << options.epsilon << ",\n"
+         << "    \"min_points\": " << options.minPoints << ",\n"
+         << "    \"num_threads\": " << cv::getNumThreads() << "\n"
+         << "  },\n  \"benchmarks\": [";
+
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const Result& result = results[i];
+        file << (i ? "," : "") << "\n    {\n"
+             << "      \"name\": \"" << result.name << "\",\n"
+             << "      \"iterations\": " << result.iterations << ",\n"
+             << "      \"real_time\": " << std::fixed << std::setprecision(1) << result.mean << ",\n"
+             << "      \"min_time\": " << result.min << ",\n"
+             << "      \"max_time\": " << result.max << ",\n"
+             << "      \"time_unit\": \"ns\",\n"
+             << "      \"items_per_iteration\": " << std::setprecision(0) << result.items << ",\n"
+             << "      \"ns_per_" << result.unit << "\": " << std::setprecision(4) << result.mean / std::max(result.items, 1.0) << "\n"
+             << "    }";
+    }
+    file << "\n  ]\n}\n";
+    return file.good();
+}
+
+static void usage(const char* name)
+{
+    std::cerr << "Usage: " << name << " [options]\n"
+              << "  --width N          synthetic image width (3000)\n"
+              << "  --height N         synthetic image height (2000)\n"
+              << "  --flies N          flies per synthetic vial (10), 0 skips the synthetic rack\n"
+              << "  --fly-size N       semi-major axis of a synthetic fly in px (8)\n"
+              << "  --seed N           random seed of the synthetic rack (1)\n"
+              << "  --images DIR       additionally benchmark all images of the directory\n"
+              << "  --vial-size N      vial size of the real images (150)\n"
+              << "  --threshold N      (100)\n"
+              << "  --epsilon N        (5)\n"
+              << "  --min-points N     (32)\n"
+              << "  --pixels-per-fly N (100)\n"
+              << "  --repetitions N    (5)\n"
+              << "  --min-time S       minimum seconds per repetition (0.2)\n"
+              << "  --filter TEXT      only run benchmarks whose name contains TEXT\n"
+              << "  --json FILE        write the results as JSON" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string argument = argv[i];
+        if (argument == "--help" || i + 1 >= argc)
+        {
+            usage(argv[0]);
+            return argument == "--help" ? 0 : -1;
+        }
+
+        std::string value = argv[++i];
+        if      (argument == "--width")       options.width       = std::atoi(value.c_str());
+        else if (argument == "--height")      options.height      = std::atoi(value.c_str());
+        else if (argument == "--flies")       options.flies       = std::atoi(value.c_str());
+        else if (argument == "--fly-size")    options.flySize     = std::atoi(value.c_str());
+        else if (argument == "--seed")        options.seed        = (unsigned)std::atol(value.c_str());
+        else if (argument == "--images")      options.images      = value;
+        else if (argument == "--vial-size")   options.vialSize    = std::atoi(value.c_str());
+        else if (argument == "--threshold")   options.threshold   = std::atoi(value.c_str());
+        else if (argument == "--epsilon")     options.epsilon     = std::atoi(value.c_str());
+        else if (argument == "--min-points")  options.minPoints   = std::atoi(value.c_str());
+        else if (argument == "--pixels-per-fly") options.pixelsPerFly = std::atoi(value.c_str());
+        else if (argument == "--repetitions") options.repetitions = std::max(std::atoi(value.c_str()), 1);
+        else if (argument == "--min-time")    options.minTime     = std::atof(value.c_str());
+        else if (argument == "--filter")      options.filter      = value;
+        else if (argument == "--json")        options.json        = value;
+        else
+        {
+            usage(argv[0]);
+            return -1;
+        }
+    }
+
+    std::vector<Frame> frames;
+    if (options.flies > 0)
+    {
+        frames.push_back(generateRack(options));
+    }
+    if (!options.images.empty())
+    {
+        std::vector<Frame> images = loadImages(options);
+        frames.insert(frames.end(), images.begin(), images.end());
+    }
+
+    std::vector<Result> results;
+    for (const Frame& frame : frames)
+    {
+        benchmarkFrame(frame, options, results);
+    }
+
+    if (!options.json.empty() && !writeJSON(options.json, options, results))
+    {
+        std::cerr << "Could not write " << options.json << std::endl;
+        return -1;
+    }
+    return 0;
+}
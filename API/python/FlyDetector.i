@@ -2,8 +2,19 @@
 
 %{
     #define SWIG_FILE_WITH_INIT
+    #include "backgroundmodel.h"
+    #include "flycalibrator.h"
     #include "flycounter.h"
+    #include "flytracker.h"
+    #include "greenscreendetector.h"
+    #include "houghdetector.h"
+    #include "lenscorrection.h"
+    #include "racklayout.h"
+    #include "sparsemask.h"
     #include "vials.h"
+#ifdef WITH_HDF5
+    #include "dataset.h"
+#endif
 %}
 
 /* Convert C++ exceptions to Python exception */ 
@@ -16,6 +27,30 @@
    } 
 } 
 
+/* Batch counting runs without the GIL so that Python threads keep going, exceptions are raised once it is re-acquired */
+%define %nogil(function)
+%exception function {
+   std::string error;
+   Py_BEGIN_ALLOW_THREADS
+   try {
+      $action
+   } catch (std::exception &e) {
+      error = e.what();
+   }
+   Py_END_ALLOW_THREADS
+   if (!error.empty()) {
+      PyErr_SetString(PyExc_Exception, error.c_str());
+      return NULL;
+   }
+}
+%enddef
+
+%nogil(FlyCounter::countBatch)
+%nogil(FlyCounter::countCrops)
+%nogil(DatasetReader::next)
+%nogil(DatasetWriter::append)
+%nogil(DatasetWriter::close)
+
 /* Wrap std::string */
 %include std_string.i
 
@@ -27,8 +62,25 @@
 
 /*Wrap FlyCounter*/
 %include "flycounter.h"
+%include "scanstats.h"
+%include "rundbscan.h"
+%template(Runs) std::vector<Run>;
 %include "vials.h"
 %template(Vials) std::vector<Vial>;
+%include "racklayout.h"
+%newobject createVialDetector;
+%include "vialdetector.h"
+%include "greenscreendetector.h"
+%include "houghdetector.h"
+%include "lenscorrection.h"
+%include "sparsemask.h"
+%include "flycalibrator.h"
+%include "backgroundmodel.h"
+%include "flytracker.h"
+%template(Tracks) std::vector<Track>;
+#ifdef WITH_HDF5
+%include "dataset.h"
+#endif
 
 /* Remove unwanted *_swigregister globals */
 %pythoncode %{
@@ -1,98 +1,168 @@
 #define NPY_NO_DEPRECATED_API NPY_1_7_API_VERSION
 
-#include <opencv2/opencv.hpp> 
+#include <opencv2/opencv.hpp>
 #include <Python.h>
 #include <numpy/arrayobject.h>
 #include <numpy/ndarraytypes.h>
 
-cv::Mat* toCV(PyArrayObject* np_array, bool copy=true)
+/* OpenCV type of a numpy array with the given number of channels, -1 if there is none */
+int toCVType(int npyType, int channels)
 {
-    int channels = 1;  
+    switch(npyType)
+    {
+        case NPY_INT8: return CV_8SC(channels);
+        case NPY_INT16: return CV_16SC(channels);
+        case NPY_INT32: return CV_32SC(channels);
+        case NPY_UINT8: return CV_8UC(channels);
+        case NPY_UINT16: return CV_16UC(channels);
+        case NPY_FLOAT32: return CV_32FC(channels);
+        case NPY_FLOAT64: return CV_64FC(channels);
+        default : return -1;
+    }
+}
+
+/* numpy type of an OpenCV depth, -1 if there is none */
+int toNumpyType(int depth)
+{
+    switch(depth)
+    {
+        case CV_8S : return NPY_INT8;
+        case CV_16S : return NPY_INT16;
+        case CV_32S: return NPY_INT32;
+        case CV_8U : return NPY_UINT8;
+        case CV_16U : return NPY_UINT16;
+        case CV_32F : return NPY_FLOAT32;
+        case CV_64F : return NPY_FLOAT64;
+        default : return -1;
+    }
+}
+
+/* a Mat can view the array if the pixels of a row are packed, the rows themselves may be strided */
+bool isViewable(PyArrayObject* np_array)
+{
+    if (!PyArray_ISALIGNED(np_array) || !PyArray_ISNOTSWAPPED(np_array)) return false;
+
+    const int       ndims    = PyArray_NDIM(np_array);
+    const npy_intp* dims     = PyArray_DIMS(np_array);
+    const npy_intp* strides  = PyArray_STRIDES(np_array);
+    npy_intp        expected = PyArray_ITEMSIZE(np_array);
+
+    // everything but the outermost dimension is packed, the outermost stride is at least the packed size
+    for (int i = ndims - 1; i > 0; --i)
+    {
+        if (dims[i] > 1 && strides[i] != expected) return false;
+        expected *= dims[i];
+    }
+    return ndims == 0 || dims[0] <= 1 || strides[0] >= expected;
+}
+
+/* Wraps the array as a Mat without copying. Arrays that cannot be viewed are copied into a
+   contiguous array that is returned in owner and has to be released after the Mat is used.
+   Returns false with a Python error set if the array is not supported. */
+bool toCV(PyArrayObject* np_array, cv::Mat& mat, PyArrayObject*& owner)
+{
+    owner = NULL;
+    int channels = 1;
     int ndims = PyArray_NDIM(np_array);
     if(ndims > 2)
     {
-	channels = (int)PyArray_DIMS(np_array)[2];
-	ndims = 2;
-    } 
-    int dims[ndims];
-    for (int i = 0; i< ndims;i++)
-	dims[i] = (int)PyArray_DIMS(np_array)[i];
-    int type;
-    switch(PyArray_TYPE(np_array))
-    {   
-        case NPY_INT8: type = CV_8SC(channels); break;
-        case NPY_INT16: type = CV_16SC(channels); break;
-        case NPY_INT32: type = CV_32SC(channels); break;
-        case NPY_UINT8: type = CV_8UC(channels); break;
-        case NPY_UINT16: type = CV_16UC(channels); break;
-        case NPY_FLOAT32: type = CV_32FC(channels); break;
-        case NPY_FLOAT64: type = CV_64FC(channels); break;
-        default : 
-        {
-            PyErr_SetString(PyExc_ValueError,"The provided type is not supported");
-            return NULL;
-        }
-    }   
-    
+	channels = (int)PyArray_DIMS(np_array)[ndims - 1];
+	ndims--;
+    }
+    int type = toCVType(PyArray_TYPE(np_array), channels);
+    if (type < 0 || ndims > 3)
+    {
+        PyErr_SetString(PyExc_ValueError,"The provided type is not supported");
+        return false;
+    }
+
+    if (!isViewable(np_array))
+    {
+        PyArray_Descr* descr = PyArray_DescrFromType(PyArray_TYPE(np_array));
+        owner = (PyArrayObject*)PyArray_FromAny((PyObject*)np_array, descr, 0, 0, NPY_ARRAY_CARRAY_RO, NULL);
+        if (owner == NULL) return false;
+        np_array = owner;
+    }
+
+    // 2-D arrays are single channel images, higher ones have their channels in the last dimension
+    int    dims[3];
+    size_t steps[3];
+    for (int i = 0; i < ndims; i++)
+    {
+	dims[i]  = (int)PyArray_DIMS(np_array)[i];
+        steps[i] = (size_t)PyArray_STRIDES(np_array)[i];
+    }
     char* data = (char*)PyArray_DATA(np_array);
-    cv::Mat* ret;
-    if ((copy))
+    if (ndims > 1 && dims[0] > 1)
     {
-	int nbytes = PyArray_NBYTES(np_array);
-        ret = new cv::Mat(ndims, dims, type);
-        std::copy(data, data + nbytes, ret->data);
+        mat = cv::Mat(ndims, dims, type, data, steps);
     }
     else
     {
-        ret = new cv::Mat(ndims, dims, type, data);
-    };
-    return ret;
+        mat = cv::Mat(ndims, dims, type, data);
+    }
+    return true;
 }
 
-PyObject* toNumpy(cv::Mat* cv_mat, bool copy = true)
-{  
-    int ndims = cv_mat->dims;
-    int channels = cv_mat->channels();
+static void releaseMat(PyObject* capsule)
+{
+    delete (cv::Mat*)PyCapsule_GetPointer(capsule, "cv::Mat");
+}
+
+/* Returns an array sharing the buffer of the Mat, a copy of the Mat header owned by the array keeps the buffer alive.
+   Mats on foreign buffers are copied since their lifetime cannot be tied to the array. Views of buffers that must
+   not be changed from Python are returned read-only. */
+PyObject* toNumpy(const cv::Mat& cv_mat, bool writeable = true)
+{
+    int type = toNumpyType(cv_mat.depth());
+    if (type < 0)
+    {
+        PyErr_SetString(PyExc_ValueError,"The provided type is not supported");
+        return NULL;
+    }
+
+#if CV_MAJOR_VERSION >= 3
+    const bool owned = cv_mat.u != NULL;
+#else
+    const bool owned = cv_mat.refcount != NULL;
+#endif
+    cv::Mat* mat = new cv::Mat(owned ? cv_mat : cv_mat.clone());
+
+    int ndims = mat->dims;
+    int channels = mat->channels();
     if(channels > 1)
 	ndims++;
-    npy_intp dims[ndims];
-    for (int i = 0; i < ndims; i++) 
-        dims[i] = cv_mat->size[i];
+    npy_intp dims[CV_MAX_DIM + 1];
+    npy_intp strides[CV_MAX_DIM + 1];
+    for (int i = 0; i < mat->dims; i++)
+    {
+        dims[i]    = mat->size[i];
+        strides[i] = mat->step[i];
+    }
     if(channels > 1)
-    	dims[ndims - 1]=channels;
-    
-    int type;
-    switch(cv_mat->depth())
-    {   
-        case CV_8S : type = NPY_INT8; break;
-        case CV_16S : type = NPY_INT16; break;
-        case CV_32S: type = NPY_INT32; break;
-        case CV_8U : type = NPY_UINT8; break;
-        case CV_16U : type = NPY_UINT16; break;
-        case CV_32F : type = NPY_FLOAT32; break;
-        case CV_64F : type = NPY_FLOAT64; break;
-        default : 
-        {
-            PyErr_SetString(PyExc_ValueError,"The provided type is not supported");
-            return NULL;
-        }
+    {
+    	dims[ndims - 1]    = channels;
+        strides[ndims - 1] = mat->elemSize1();
     }
-    void* data;
-    bool owner = true;
-    if(!copy)
-    { 
-        data = cv_mat->data;
-        owner = false;
+
+    PyObject* array = PyArray_New(&PyArray_Type, ndims, dims, type, strides, mat->data, 0, writeable ? NPY_ARRAY_WRITEABLE : 0, NULL);
+    if (array == NULL)
+    {
+        delete mat;
+        return NULL;
     }
-    else
+    PyObject* base = PyCapsule_New(mat, "cv::Mat", releaseMat);
+    if (base == NULL)
+    {
+        delete mat;
+        Py_DECREF(array);
+        return NULL;
+    }
+    // steals the capsule reference, also on failure
+    if (PyArray_SetBaseObject((PyArrayObject*)array, base) < 0)
     {
-	int nbytes = cv_mat->total()*cv_mat->elemSize();
-	uchar* d = cv_mat->data;
-        data = new char[nbytes];
-        std::copy(d, d + nbytes, (uchar*)data);
+        Py_DECREF(array);
+        return NULL;
     }
-    PyObject* array = PyArray_SimpleNewFromData(ndims, dims, type, data);
-    if(owner)
-        PyArray_ENABLEFLAGS((PyArrayObject*) array, NPY_ARRAY_OWNDATA);
     return array;
 }
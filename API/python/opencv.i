@@ -12,39 +12,62 @@ import_array();
    $1 = PyArray_Check($input) ? 1 : 0;
 }
 
+/* arrays with packed rows are passed as views, others are copied into a temporary contiguous array */
 %typemap(in)
-( const cv::Mat & ),
-(       cv::Mat & ) 
+( const cv::Mat & ) (cv::Mat mat, PyArrayObject* owner = NULL)
 {
-    PyArrayObject *temp=NULL;
-    if (PyArray_Check($input))
-        temp = (PyArrayObject*)$input; 
-    else    
+    if (!PyArray_Check($input))
     {
         PyErr_SetString(PyExc_ValueError,"Input object is not an array");
         return NULL;
     }
-    $1=toCV(temp, false);
+    if (!toCV((PyArrayObject*)$input, mat, owner))
+        return NULL;
+    $1 = &mat;
 }
 
-%typemap(freearg)
-( const cv::Mat & ),
-(       cv::Mat & ) 
+/* output arrays are always viewed, writes to a temporary copy would be lost */
+%typemap(in)
+( cv::Mat & ) (cv::Mat mat, PyArrayObject* owner = NULL)
 {
-   delete $1;
+    if (!PyArray_Check($input))
+    {
+        PyErr_SetString(PyExc_ValueError,"Input object is not an array");
+        return NULL;
+    }
+    if (!isViewable((PyArrayObject*)$input) || !PyArray_ISWRITEABLE((PyArrayObject*)$input))
+    {
+        PyErr_SetString(PyExc_ValueError,"Output array must be writeable with packed rows, pass a contiguous copy");
+        return NULL;
+    }
+    if (!toCV((PyArrayObject*)$input, mat, owner))
+        return NULL;
+    $1 = &mat;
 }
 
-%typemap(out)
+%typemap(freearg)
 ( const cv::Mat & ),
 (       cv::Mat & )
 {
-    $result = toNumpy($1, true);
+   Py_XDECREF(owner$argnum);
 }
 
+/* results share their buffer with the returned array, returned references see later changes of the referenced Mat */
 %typemap(out)
-(cv::Mat)
+( cv::Mat & )
 {
-    $result = toNumpy(&$1, true);
+    $result = toNumpy(*$1);
 }
 
+/* const references view internal buffers, the array is read-only */
+%typemap(out)
+( const cv::Mat & )
+{
+    $result = toNumpy(*$1, false);
+}
 
+%typemap(out)
+(cv::Mat)
+{
+    $result = toNumpy($1);
+}
@@ -1,7 +1,5 @@
 import numpy as np
 from FlyDetector import *
-import h5py as h5
-from PIL import Image
 import sys
 
 
@@ -10,22 +8,26 @@ if sys.argv !=  6:
 input_path = sys.argv[1]
 label_count = dict()
 mse_count = dict()
-flies = h5.File(input_path)
-images = flies["data"][:]
-label = flies["label"][:,0]
 fc = FlyCounter()
 fc.setThreshold(int(sys.argv[2]))
 fc.setEpsilon(int(sys.argv[3]))
 fc.setMinPoints(int(sys.argv[4]))
 fc.setPixelsPerFly(int(sys.argv[5]))
 mse = 0.0;
+
+# the dataset is streamed in batches of single-vial crops, each batch is counted in parallel against one vial template
+dataset = DatasetReader(input_path)
+counts = []
+labels = []
+while dataset.next():
+    counts.append(fc.countCrops(dataset.getImages(), 150)[:,0])
+    labels.append(dataset.getLabels()[:,0])
+counts = np.concatenate(counts)
+label = np.concatenate(labels)
 ssm = np.sum(np.square(label -label.mean()))
-    
-for i in range(images.shape[0]):
-    print(i+1,"/",images.shape[0])
-    img = np.rollaxis(images[i],0,3).copy()
-    vials = findVials(img, 150)
-    f = fc.count(img, vials)
+
+for i in range(label.shape[0]):
+    f = counts[i]
     l =  label[i]
     mse += (f - l)**2
     if l in label_count:
@@ -35,7 +37,7 @@ for i in range(images.shape[0]):
         label_count[l]=1
         mse_count[l] = (f-l)**2 
 r2 = 1 - mse / ssm
-mse /= images.shape[0]
+mse /= label.shape[0]
 print("MSE:",mse)
 print("R2:",r2)
 print("Class Distribution:")
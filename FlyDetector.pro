@@ -23,14 +23,31 @@ SOURCES += main.cpp\
     reflexcam.cpp \
     dbscan/hpdbscan.cpp \
     dbscan/points.cpp \
+    dbscan/rundbscan.cpp \
     dbscan/rules.cpp \
     dbscan/space.cpp \
     vials.cpp \
+    racklayout.cpp \
+    vialdetector.cpp \
+    greenscreendetector.cpp \
+    houghdetector.cpp \
+    lenscorrection.cpp \
     usbshaker.cpp \
     noshaker.cpp \
     logger.cpp \
     flycountercontroller.cpp \
-    flycounter.cpp
+    flycounter.cpp \
+    flycalibrator.cpp \
+    backgroundmodel.cpp \
+    flytracker.cpp \
+    resultwriter.cpp \
+    experimentlog.cpp \
+    imagearchiver.cpp \
+    sparsemask.cpp \
+    profiler.cpp \
+    tracer.cpp \
+    analysispool.cpp \
+    rackcontroller.cpp
 
 HEADERS  += mainwindow.h \
     cam.h \
@@ -40,17 +57,35 @@ HEADERS  += mainwindow.h \
     dbscan/constants.h \
     dbscan/hpdbscan.h \
     dbscan/points.h \
+    dbscan/rundbscan.h \
     dbscan/rules.h \
+    dbscan/scanstats.h \
     dbscan/space.h \
     dbscan/util.h \
     timer.h \
     vials.h \
+    racklayout.h \
+    vialdetector.h \
+    greenscreendetector.h \
+    houghdetector.h \
+    lenscorrection.h \
     usbshaker.h \
     shaker.h \
     noshaker.h \
     logger.h \
     flycountercontroller.h \
-    flycounter.h
+    flycounter.h \
+    flycalibrator.h \
+    backgroundmodel.h \
+    flytracker.h \
+    resultwriter.h \
+    experimentlog.h \
+    imagearchiver.h \
+    sparsemask.h \
+    profiler.h \
+    tracer.h \
+    analysispool.h \
+    rackcontroller.h
 
 FORMS    += mainwindow.ui
 
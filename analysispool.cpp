@@ -0,0 +1,70 @@
+#include "analysispool.h"
+
+#include <algorithm>
+#include <future>
+#include <memory>
+
+#include "tracer.h"
+
+AnalysisPool::AnalysisPool(int workers)
+:
+running(true)
+{
+    for (int i = 0; i < std::max(workers, 1); ++i)
+    {
+        this->threads.push_back(std::thread(&AnalysisPool::work, this));
+    }
+}
+
+/* worker thread mainloop */
+void AnalysisPool::work()
+{
+    Tracer::setThreadName("analysis");
+    std::unique_lock<std::mutex> lock(this->mutex);
+    while (this->running || !this->tasks.empty())
+    {
+        if (this->tasks.empty())
+        {
+            this->condition.wait(lock);
+            continue;
+        }
+
+        std::function<void()> task = std::move(this->tasks.front());
+        this->tasks.pop_front();
+
+        lock.unlock();
+        task();
+        lock.lock();
+    }
+}
+
+void AnalysisPool::run(const std::function<void()>& task)
+{
+    auto packaged = std::make_shared<std::packaged_task<void()>>(task);
+    std::future<void> done = packaged->get_future();
+
+    this->mutex.lock();
+    this->tasks.push_back([packaged]() { (*packaged)(); });
+    this->mutex.unlock();
+    this->condition.notify_one();
+
+    done.get();
+}
+
+int AnalysisPool::size() const
+{
+    return (int)this->threads.size();
+}
+
+AnalysisPool::~AnalysisPool()
+{
+    this->mutex.lock();
+    this->running = false;
+    this->mutex.unlock();
+    this->condition.notify_all();
+
+    for (std::thread& thread : this->threads)
+    {
+        thread.join();
+    }
+}
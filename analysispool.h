@@ -0,0 +1,33 @@
+#ifndef ANALYSISPOOL_H
+#define ANALYSISPOOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* Worker threads shared by the racks of one process, bounds the number of images analyzed at the same time */
+class AnalysisPool
+{
+protected:
+    std::deque<std::function<void()>> tasks;
+    std::mutex                        mutex;
+    std::condition_variable           condition;
+    std::vector<std::thread>          threads;
+    bool                              running;
+
+    void work();
+
+public:
+    explicit AnalysisPool(int workers);
+
+    /* Runs the task on one of the workers and waits until it is done, exceptions are passed on to the caller */
+    void run(const std::function<void()>& task);
+    int  size() const;
+
+    ~AnalysisPool();
+};
+
+#endif // ANALYSISPOOL_H
@@ -0,0 +1,115 @@
+#include "backgroundmodel.h"
+
+#include "sparsemask.h"
+
+BackgroundModel::BackgroundModel()
+:
+frames(0),
+trainingFrames(0)
+{
+
+}
+
+void BackgroundModel::add(const cv::Mat& thresh)
+{
+    if (!this->isEnabled() || this->isTrained() || thresh.empty()) return;
+
+    // running per-pixel minimum of the binary images - only pixels that never changed survive
+    if (this->staticPixels.size() != thresh.size())
+    {
+        this->staticPixels = thresh.clone();
+        this->frames       = 0;
+    }
+    else
+    {
+        cv::min(this->staticPixels, thresh, this->staticPixels);
+    }
+    ++this->frames;
+
+    if (this->isTrained())
+    {
+        cv::dilate(this->staticPixels, this->staticPixels, cv::Mat(), cv::Point(-1, -1), DILATION);
+    }
+}
+
+/* the runs are only rendered during training, afterwards the model works on the runs alone */
+void BackgroundModel::add(const Vials& vials, const cv::Size& size)
+{
+    if (!this->isEnabled() || this->isTrained()) return;
+
+    this->scratch.create(size, CV_8UC1);
+    this->scratch.setTo(cv::Scalar(0));
+    for (const Vial& vial : vials)
+    {
+        drawRuns(vial.runs, this->scratch);
+    }
+    this->add(this->scratch);
+}
+
+void BackgroundModel::apply(cv::Mat& thresh) const
+{
+    if (!this->isTrained() || thresh.size() != this->staticPixels.size()) return;
+
+    thresh.setTo(cv::Scalar(0), this->staticPixels);
+}
+
+/* splits the runs at the static pixels, the run pixel order stays the same */
+void BackgroundModel::apply(Vials& vials) const
+{
+    if (!this->isTrained()) return;
+
+    Runs remaining;
+    for (Vial& vial : vials)
+    {
+        remaining.clear();
+        for (const Run& run : vial.runs)
+        {
+            if (run.row >= this->staticPixels.rows || run.end > this->staticPixels.cols) continue;
+
+            const uchar* row = this->staticPixels.ptr<uchar>(run.row);
+            for (int x = run.begin; x < run.end; ++x)
+            {
+                if (row[x]) continue;
+
+                int begin = x;
+                while (x < run.end && !row[x]) ++x;
+                remaining.push_back(Run(run.row, begin, x));
+            }
+        }
+        vial.runs.swap(remaining);
+    }
+}
+
+bool BackgroundModel::isEnabled() const
+{
+    return this->trainingFrames > 0;
+}
+
+bool BackgroundModel::isTrained() const
+{
+    return this->isEnabled() && this->frames >= this->trainingFrames;
+}
+
+void BackgroundModel::reset()
+{
+    this->staticPixels = cv::Mat();
+    this->frames       = 0;
+}
+
+/* getters */
+const cv::Mat& BackgroundModel::getMask() const
+{
+    return this->staticPixels;
+}
+
+int BackgroundModel::getTrainingFrames() const
+{
+    return this->trainingFrames;
+}
+
+/* setters */
+void BackgroundModel::setTrainingFrames(int value)
+{
+    this->trainingFrames = value;
+    this->reset();
+}
@@ -0,0 +1,42 @@
+#ifndef BACKGROUNDMODEL_H
+#define BACKGROUNDMODEL_H
+
+#include <opencv2/opencv.hpp>
+
+#include "vials.h"
+
+/* Learns the static foreground (vial rims, food, labels, ...) from the first threshold images of an experiment */
+class BackgroundModel
+{
+protected:
+    cv::Mat staticPixels;
+    cv::Mat scratch; // rendered runs while training
+    int     frames;
+    int     trainingFrames;
+
+public:
+    static const int DILATION = 1; // px, tolerates small jitter of the static edges
+
+    BackgroundModel();
+
+    /* Accumulates a threshold image, the pixels that are foreground in every training frame become background */
+    void add(const cv::Mat& thresh);
+    void add(const Vials& vials, const cv::Size& size);
+
+    /* Removes the learned static pixels from the passed threshold image or vial runs, no-op while still training */
+    void apply(cv::Mat& thresh) const;
+    void apply(Vials& vials) const;
+
+    bool isEnabled() const;
+    bool isTrained() const;
+    void reset();
+
+    /* Getters */
+    const cv::Mat& getMask() const;
+    int getTrainingFrames() const;
+
+    /* Setters */
+    void setTrainingFrames(int value);
+};
+
+#endif // BACKGROUNDMODEL_H
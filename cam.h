@@ -1,6 +1,8 @@
 #ifndef CAM_H
 #define CAM_H
 
+#include <vector>
+
 #include <opencv2/opencv.hpp>
 
 /* Abstract camera interface */
@@ -17,6 +19,9 @@ public:
     /* Reads an image from the camera into the mat parameter and returns true if successful, false otherwise */
     virtual bool getImage(cv::Mat& mat) = 0;
 
+    /* Copies the encoded file of the last image into the data parameter, returns false if the camera does not deliver encoded images */
+    virtual bool getEncoded(std::vector<uchar>& data) { (void)data; return false; }
+
     virtual ~Cam() {}
 };
 
@@ -0,0 +1,441 @@
+#include "dataset.h"
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+
+/* the HDF5 library is not necessarily built thread-safe, all calls are serialized */
+static std::mutex hdf5Lock;
+
+static const cv::Scalar GREEN = cv::Scalar(0, 255, 0);
+
+static void closeHandles(hid_t& file, hid_t& data, hid_t& label)
+{
+    if (label >= 0) H5Dclose(label);
+    if (data  >= 0) H5Dclose(data);
+    if (file  >= 0) H5Fclose(file);
+    file = data = label = -1;
+}
+
+/* extendible along the first dimension, the other dimensions are fixed to those of the chunk */
+static hid_t createDataset(hid_t file, const char* name, int rank, const hsize_t* chunk)
+{
+    hsize_t dims[4];
+    hsize_t maxDims[4];
+    for (int i = 0; i < rank; ++i)
+    {
+        dims[i]    = i == 0 ? 0 : chunk[i];
+        maxDims[i] = i == 0 ? H5S_UNLIMITED : chunk[i];
+    }
+
+    hid_t space      = H5Screate_simple(rank, dims, maxDims);
+    hid_t properties = H5Pcreate(H5P_DATASET_CREATE);
+    H5Pset_chunk(properties, rank, chunk);
+    hid_t dataset = H5Dcreate2(file, name, H5T_STD_U8LE, space, H5P_DEFAULT, properties, H5P_DEFAULT);
+    H5Pclose(properties);
+    H5Sclose(space);
+
+    return dataset;
+}
+
+/* reads or writes the rows [start, start + extent[0]) of a dataset */
+static bool transfer(hid_t dataset, hid_t type, const hsize_t* offset, const hsize_t* extent, void* buffer, bool write)
+{
+    hid_t fileSpace = H5Dget_space(dataset);
+    const int rank  = H5Sget_simple_extent_ndims(fileSpace);
+    H5Sselect_hyperslab(fileSpace, H5S_SELECT_SET, offset, NULL, extent, NULL);
+    hid_t memorySpace = H5Screate_simple(rank, extent, NULL);
+
+    herr_t status = write ? H5Dwrite(dataset, type, memorySpace, fileSpace, H5P_DEFAULT, buffer)
+                          : H5Dread(dataset, type, memorySpace, fileSpace, H5P_DEFAULT, buffer);
+    H5Sclose(memorySpace);
+    H5Sclose(fileSpace);
+
+    return status >= 0;
+}
+
+static int rankOf(hid_t dataset, hsize_t* dims)
+{
+    hid_t space = H5Dget_space(dataset);
+    int   rank  = H5Sget_simple_extent_ndims(space);
+    if (rank > 0 && rank <= 4)
+    {
+        H5Sget_simple_extent_dims(space, dims, NULL);
+    }
+    H5Sclose(space);
+
+    return rank;
+}
+
+static cv::Mat cropCenters(const cv::Mat& image, const std::vector<cv::Point>& centers, int height, int width)
+{
+    const int dims[3] = {(int)centers.size(), height, width};
+    cv::Mat crops(3, dims, image.type());
+    const cv::Rect frame(0, 0, image.cols, image.rows);
+
+    #pragma omp parallel for
+    for (int i = 0; i < (int)centers.size(); ++i)
+    {
+        cv::Mat crop(height, width, image.type(), crops.ptr(i));
+        const cv::Rect roi(centers[i].x - width / 2, centers[i].y - height / 2, width, height);
+        const cv::Rect visible = roi & frame;
+
+        // only the border outside of the image is filled instead of padding the whole image
+        crop.setTo(GREEN);
+        if (visible.area() > 0)
+        {
+            image(visible).copyTo(crop(visible - roi.tl()));
+        }
+    }
+    return crops;
+}
+
+cv::Mat cropVials(const cv::Mat& image, const Vials& vials, int height, int width)
+{
+    std::vector<cv::Point> centers;
+    for (const Vial& vial : vials)
+    {
+        centers.push_back(vial.center);
+    }
+    return cropCenters(image, centers, height, width);
+}
+
+cv::Mat cropVials(const cv::Mat& image, const cv::Mat& centers, int height, int width)
+{
+    if (centers.type() != CV_32SC1 || centers.cols != 2)
+    {
+        throw std::invalid_argument("cropVials expects the centers as an N x 2 int32 array");
+    }
+
+    std::vector<cv::Point> points;
+    for (int i = 0; i < centers.rows; ++i)
+    {
+        points.push_back(cv::Point(centers.at<int>(i, 0), centers.at<int>(i, 1)));
+    }
+    return cropCenters(image, points, height, width);
+}
+
+/** DatasetReader **/
+
+DatasetReader::DatasetReader(const std::string& path, size_t batchSize)
+:
+file(-1),
+data(-1),
+label(-1),
+count(0),
+height(0),
+width(0),
+batchSize(std::max(batchSize, (size_t)1)),
+running(true),
+finished(false)
+{
+    {
+        std::lock_guard<std::mutex> lock(hdf5Lock);
+        hsize_t dims[4]      = {0, 0, 0, 0};
+        hsize_t labelDims[4] = {0, 0, 0, 0};
+
+        this->file = H5Fopen(path.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+        if (this->file >= 0)
+        {
+            this->data  = H5Dopen2(this->file, "data",  H5P_DEFAULT);
+            this->label = H5Dopen2(this->file, "label", H5P_DEFAULT);
+        }
+        if (this->data < 0 || this->label < 0 || rankOf(this->data, dims) != 4 || dims[1] != 3 || rankOf(this->label, labelDims) < 1 || labelDims[0] != dims[0])
+        {
+            closeHandles(this->file, this->data, this->label);
+            throw std::runtime_error("Could not open dataset " + path);
+        }
+        this->count  = dims[0];
+        this->height = (int)dims[2];
+        this->width  = (int)dims[3];
+    }
+    this->thread = std::thread(&DatasetReader::work, this);
+}
+
+/* reader thread mainloop */
+void DatasetReader::work()
+{
+    for (size_t start = 0; start < this->count; start += this->batchSize)
+    {
+        Batch batch;
+        bool  ok = this->read(start, std::min(this->batchSize, this->count - start), batch);
+
+        std::unique_lock<std::mutex> lock(this->mutex);
+        if (!ok)
+        {
+            this->error = "Could not read dataset";
+            break;
+        }
+        this->condition.wait(lock, [this] { return !this->running || this->batches.size() < MAX_PENDING; });
+        if (!this->running) break;
+
+        this->batches.push_back(std::move(batch));
+        this->condition.notify_all();
+    }
+
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->finished = true;
+    this->condition.notify_all();
+}
+
+bool DatasetReader::read(size_t start, size_t n, Batch& batch)
+{
+    const size_t plane = (size_t)this->height * this->width;
+    std::vector<uchar> pixels(n * 3 * plane);
+    std::vector<int>   labels(n);
+    {
+        std::lock_guard<std::mutex> lock(hdf5Lock);
+        const hsize_t offset[4]    = {start, 0, 0, 0};
+        const hsize_t extent[4]    = {n, 3, (hsize_t)this->height, (hsize_t)this->width};
+        const hsize_t labelDims[4] = {n, 1, 1, 1};
+
+        if (!transfer(this->data,  H5T_NATIVE_UINT8, offset, extent,    pixels.data(), false)) return false;
+        if (!transfer(this->label, H5T_NATIVE_INT,   offset, labelDims, labels.data(), false)) return false;
+    }
+
+    // channel first planes to interleaved pixels
+    const int dims[3] = {(int)n, this->height, this->width};
+    batch.images.create(3, dims, CV_8UC3);
+    #pragma omp parallel for
+    for (int i = 0; i < (int)n; ++i)
+    {
+        uchar*  source    = pixels.data() + i * 3 * plane;
+        cv::Mat planes[3] = {
+            cv::Mat(this->height, this->width, CV_8UC1, source),
+            cv::Mat(this->height, this->width, CV_8UC1, source + plane),
+            cv::Mat(this->height, this->width, CV_8UC1, source + 2 * plane)
+        };
+        cv::Mat image(this->height, this->width, CV_8UC3, batch.images.ptr(i));
+        cv::merge(planes, 3, image);
+    }
+    batch.labels = cv::Mat(labels, true);
+
+    return true;
+}
+
+bool DatasetReader::next()
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    this->condition.wait(lock, [this] { return !this->batches.empty() || this->finished; });
+    if (this->batches.empty())
+    {
+        this->current = Batch();
+        if (!this->error.empty())
+        {
+            throw std::runtime_error(this->error);
+        }
+        return false;
+    }
+
+    this->current = std::move(this->batches.front());
+    this->batches.pop_front();
+    this->condition.notify_all();
+
+    return true;
+}
+
+const cv::Mat& DatasetReader::getImages() const
+{
+    return this->current.images;
+}
+
+const cv::Mat& DatasetReader::getLabels() const
+{
+    return this->current.labels;
+}
+
+size_t DatasetReader::size() const
+{
+    return this->count;
+}
+
+int DatasetReader::getHeight() const
+{
+    return this->height;
+}
+
+int DatasetReader::getWidth() const
+{
+    return this->width;
+}
+
+DatasetReader::~DatasetReader()
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->running = false;
+    }
+    this->condition.notify_all();
+    if (this->thread.joinable())
+    {
+        this->thread.join();
+    }
+
+    std::lock_guard<std::mutex> lock(hdf5Lock);
+    closeHandles(this->file, this->data, this->label);
+}
+
+/** DatasetWriter **/
+
+DatasetWriter::DatasetWriter(const std::string& path, int height, int width)
+:
+file(-1),
+data(-1),
+label(-1),
+count(0),
+height(height),
+width(width),
+running(true)
+{
+    {
+        std::lock_guard<std::mutex> lock(hdf5Lock);
+        const bool exists = std::ifstream(path).good();
+
+        this->file = exists ? H5Fopen(path.c_str(), H5F_ACC_RDWR, H5P_DEFAULT)
+                            : H5Fcreate(path.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+        if (this->file >= 0 && H5Lexists(this->file, "data", H5P_DEFAULT) > 0)
+        {
+            hsize_t dims[4] = {0, 0, 0, 0};
+            this->data  = H5Dopen2(this->file, "data",  H5P_DEFAULT);
+            this->label = H5Dopen2(this->file, "label", H5P_DEFAULT);
+            if (this->data >= 0 && (rankOf(this->data, dims) != 4 || dims[1] != 3 || dims[2] != (hsize_t)height || dims[3] != (hsize_t)width))
+            {
+                H5Dclose(this->data);
+                this->data = -1;
+            }
+            this->count = dims[0];
+        }
+        else if (this->file >= 0)
+        {
+            const hsize_t dataChunk[4]  = {1, 3, (hsize_t)height, (hsize_t)width};
+            const hsize_t labelChunk[2] = {1024, 1};
+            this->data  = createDataset(this->file, "data",  4, dataChunk);
+            this->label = createDataset(this->file, "label", 2, labelChunk);
+        }
+
+        if (this->data < 0 || this->label < 0)
+        {
+            closeHandles(this->file, this->data, this->label);
+            throw std::runtime_error("Could not open dataset " + path + " for writing");
+        }
+    }
+    this->thread = std::thread(&DatasetWriter::work, this);
+}
+
+/* writer thread mainloop */
+void DatasetWriter::work()
+{
+    std::vector<Sample> batch;
+    std::unique_lock<std::mutex> lock(this->mutex);
+
+    while (this->running || !this->samples.empty())
+    {
+        this->condition.wait(lock, [this] { return !this->running || !this->samples.empty(); });
+        while (!this->samples.empty() && batch.size() < BATCH_SIZE)
+        {
+            batch.push_back(std::move(this->samples.front()));
+            this->samples.pop_front();
+        }
+        this->condition.notify_all();
+        if (batch.empty()) continue;
+
+        lock.unlock();
+        bool ok = this->write(batch);
+        lock.lock();
+
+        if (ok)
+        {
+            this->count += batch.size();
+        }
+        else
+        {
+            // wakes producers waiting for room so that they see the error
+            this->error = "Could not write dataset";
+            this->samples.clear();
+            this->condition.notify_all();
+        }
+        batch.clear();
+    }
+}
+
+bool DatasetWriter::write(std::vector<Sample>& batch)
+{
+    const size_t n     = batch.size();
+    const size_t plane = (size_t)this->height * this->width;
+    std::vector<uchar> pixels(n * 3 * plane);
+    std::vector<int>   labels(n);
+
+    // interleaved pixels to channel first planes
+    for (size_t i = 0; i < n; ++i)
+    {
+        uchar*  target    = pixels.data() + i * 3 * plane;
+        cv::Mat planes[3] = {
+            cv::Mat(this->height, this->width, CV_8UC1, target),
+            cv::Mat(this->height, this->width, CV_8UC1, target + plane),
+            cv::Mat(this->height, this->width, CV_8UC1, target + 2 * plane)
+        };
+        cv::split(batch[i].crop, planes);
+        labels[i] = batch[i].label;
+    }
+
+    std::lock_guard<std::mutex> lock(hdf5Lock);
+    const hsize_t offset[4]    = {this->count, 0, 0, 0};
+    const hsize_t extent[4]    = {n, 3, (hsize_t)this->height, (hsize_t)this->width};
+    const hsize_t labelDims[4] = {n, 1, 1, 1};
+    const hsize_t dataSize[4]  = {this->count + n, 3, (hsize_t)this->height, (hsize_t)this->width};
+    const hsize_t labelSize[2] = {this->count + n, 1};
+
+    if (H5Dset_extent(this->data, dataSize) < 0 || H5Dset_extent(this->label, labelSize) < 0) return false;
+    if (!transfer(this->data,  H5T_NATIVE_UINT8, offset, extent,    pixels.data(), true)) return false;
+    return transfer(this->label, H5T_NATIVE_INT, offset, labelDims, labels.data(), true);
+}
+
+void DatasetWriter::append(const cv::Mat& crop, int label)
+{
+    if (crop.rows != this->height || crop.cols != this->width || crop.type() != CV_8UC3)
+    {
+        throw std::invalid_argument("The crop does not match the dataset");
+    }
+
+    std::unique_lock<std::mutex> lock(this->mutex);
+    this->condition.wait(lock, [this] { return !this->running || !this->error.empty() || this->samples.size() < MAX_PENDING; });
+    if (!this->error.empty() || !this->running)
+    {
+        throw std::runtime_error(this->error.empty() ? "The dataset is closed" : this->error);
+    }
+
+    Sample sample;
+    sample.crop  = crop.clone();
+    sample.label = label;
+    this->samples.push_back(std::move(sample));
+    this->condition.notify_all();
+}
+
+bool DatasetWriter::close()
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->running = false;
+    }
+    this->condition.notify_all();
+    if (this->thread.joinable())
+    {
+        this->thread.join();
+    }
+
+    std::lock_guard<std::mutex> lock(hdf5Lock);
+    closeHandles(this->file, this->data, this->label);
+
+    return this->error.empty();
+}
+
+size_t DatasetWriter::size()
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return this->count;
+}
+
+DatasetWriter::~DatasetWriter()
+{
+    this->close();
+}
@@ -0,0 +1,114 @@
+#ifndef DATASET_H
+#define DATASET_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <hdf5.h>
+#include <opencv2/opencv.hpp>
+
+#include "vials.h"
+
+/* Labeled vial crop datasets as written by tools/transform.py - an HDF5 file with an
+   N x 3 x H x W uint8 "data" and an N x 1 uint8 "label" dataset, images are channel first */
+
+/* Crops of the vials centered at their centers as an N x H x W stack, out of image pixels are green like the greenscreen */
+cv::Mat cropVials(const cv::Mat& image, const Vials& vials, int height, int width);
+/* same for an N x 2 int32 array of x, y centers found by another detection */
+cv::Mat cropVials(const cv::Mat& image, const cv::Mat& centers, int height, int width);
+
+/* Streams a dataset in batches, a background thread reads ahead while the current batch is processed */
+class DatasetReader
+{
+protected:
+    struct Batch
+    {
+        cv::Mat images; // N x H x W, CV_8UC3
+        cv::Mat labels; // N x 1,     CV_32SC1
+    };
+
+    hid_t  file;
+    hid_t  data;
+    hid_t  label;
+    size_t count;
+    int    height;
+    int    width;
+    size_t batchSize;
+
+    std::deque<Batch>       batches;
+    std::mutex              mutex;
+    std::condition_variable condition;
+    std::thread             thread;
+    bool                    running;
+    bool                    finished;
+    std::string             error;
+    Batch                   current;
+
+    void work();
+    bool read(size_t start, size_t n, Batch& batch);
+
+public:
+    static const size_t MAX_PENDING = 2; // batches read ahead
+
+    DatasetReader(const std::string& path, size_t batchSize=256);
+
+    /* Waits for the next batch, false after the last one */
+    bool next();
+    const cv::Mat& getImages() const;
+    const cv::Mat& getLabels() const;
+
+    size_t size() const;
+    int getHeight() const;
+    int getWidth() const;
+
+    ~DatasetReader();
+};
+
+/* Appends labeled crops to a dataset, a background thread writes them in batches */
+class DatasetWriter
+{
+protected:
+    struct Sample
+    {
+        cv::Mat crop;
+        int     label;
+    };
+
+    hid_t  file;
+    hid_t  data;
+    hid_t  label;
+    size_t count;
+    int    height;
+    int    width;
+
+    std::deque<Sample>      samples;
+    std::mutex              mutex;
+    std::condition_variable condition;
+    std::thread             thread;
+    bool                    running;
+    std::string             error;
+
+    void work();
+    bool write(std::vector<Sample>& batch);
+
+public:
+    static const size_t BATCH_SIZE  = 64;  // crops per write
+    static const size_t MAX_PENDING = 256; // crops, append blocks until the writer caught up
+
+    /* Creates the dataset or appends to an existing one of the same crop size */
+    DatasetWriter(const std::string& path, int height, int width);
+
+    /* Queues an H x W three channel crop */
+    void append(const cv::Mat& crop, int label);
+    /* Writes all pending crops and closes the file, false if not all crops could be written */
+    bool close();
+
+    size_t size();
+
+    ~DatasetWriter();
+};
+
+#endif // DATASET_H
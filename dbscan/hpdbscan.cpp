@@ -5,20 +5,23 @@
 #include <unordered_set>
 #include <set>
 #include <iterator>
+#include <stdexcept>
 #include <omp.h>
 
 /**
  * Constructors
  */
-HPDBSCAN::HPDBSCAN(Coord* points, int npoints, int dimensions) :
-    m_points(points, npoints, dimensions)
+template <size_t D>
+DimensionalHPDBSCAN<D>::DimensionalHPDBSCAN(Coord* points, int npoints) :
+    m_points(points, npoints)
 {
 }
 
 /**
  * Internal Operations
  */
-void HPDBSCAN::applyRules(const Rules& rules)
+template <size_t D>
+void DimensionalHPDBSCAN<D>::applyRules(const Rules& rules)
 {
     #pragma omp parallel for
     for (size_t i = 0; i < this->m_points.size(); ++i)
@@ -36,7 +39,8 @@ void HPDBSCAN::applyRules(const Rules& rules)
     }
 }
 
-Rules HPDBSCAN::localDBSCAN(const Space& space, const float epsilon, const size_t minPoints)
+template <size_t D>
+Rules DimensionalHPDBSCAN<D>::localDBSCAN(const Space<D>& space, const float epsilon, const size_t minPoints)
 {
     const float      EPS2    = std::pow(epsilon, 2);
     
@@ -47,23 +51,23 @@ Rules HPDBSCAN::localDBSCAN(const Space& space, const float epsilon, const size_
     // local dbscan
     
     size_t cell = NOT_VISITED;
-    std::vector<size_t> neighborPoints;
+    const typename Space<D>::Neighborhood* neighbors = nullptr;
     
     
-    #pragma omp parallel for schedule(dynamic, 500) private(neighborPoints) firstprivate(cell) reduction(merge: rules)
+    #pragma omp parallel for schedule(dynamic, 500) firstprivate(cell, neighbors) reduction(merge: rules)
     for (size_t point = lower; point < upper; ++point)
     {
         size_t pointCell = this->m_points.cell(point);
         if (pointCell != cell)
         {
-            neighborPoints = space.getNeighbors(pointCell);
+            neighbors = &space.getNeighbors(pointCell);
             cell = pointCell;
         }
         std::vector<size_t> minPointsArea;
         ssize_t clusterId = NOISE;
-        if(neighborPoints.size() >= minPoints)
+        if(neighbors->points >= minPoints)
         {
-            clusterId =space.regionQuery(point, neighborPoints, EPS2, minPointsArea);
+            clusterId =space.regionQuery(point, *neighbors, EPS2, minPointsArea);
         }
 
         if (minPointsArea.size() >= minPoints)
@@ -94,7 +98,8 @@ Rules HPDBSCAN::localDBSCAN(const Space& space, const float epsilon, const size_
 /**
  * Operations
  */
-void HPDBSCAN::scan(float epsilon, size_t minPoints, Cluster* results)
+template <size_t D>
+void DimensionalHPDBSCAN<D>::scan(float epsilon, size_t minPoints, Cluster* results, ScanStats* stats)
 {
     if(m_points.size() == 0)
     {
@@ -102,10 +107,45 @@ void HPDBSCAN::scan(float epsilon, size_t minPoints, Cluster* results)
         return;
     }
     this->m_points.resetClusters(results);
-    Space space(this->m_points, epsilon);    
+    PhaseClock clock;
+    Space<D> space(this->m_points, epsilon);    
+    if (stats) stats->index += clock.lap();
     Rules rules = this->localDBSCAN(space, epsilon, minPoints);   
+    if (stats) stats->local += clock.lap();
     this->applyRules(rules);   
+    if (stats) stats->merge += clock.lap();
     this->m_points.sortByOrder(ceil(log10(this->m_points.size())), 0, this->m_points.size());
+    if (stats) stats->label += clock.lap();
+}
+
+template class DimensionalHPDBSCAN<1>;
+template class DimensionalHPDBSCAN<2>;
+template class DimensionalHPDBSCAN<3>;
+template class DimensionalHPDBSCAN<4>;
+
+/**
+ * Runtime dimension front end
+ */
+HPDBSCAN::HPDBSCAN(Coord* points, int npoints, int dimensions) :
+    m_data(points),
+    m_size(npoints),
+    m_dimensions(dimensions)
+{
+    if (dimensions < 1 || (size_t)dimensions > MAX_DIMENSIONS)
+    {
+        throw std::invalid_argument("HPDBSCAN supports 1 to " + std::to_string(MAX_DIMENSIONS) + " dimensions");
+    }
+}
+
+void HPDBSCAN::scan(float epsilon, size_t minPoints, Cluster* results, ScanStats* stats)
+{
+    switch (this->m_dimensions)
+    {
+        case 1: DimensionalHPDBSCAN<1>(this->m_data, this->m_size).scan(epsilon, minPoints, results, stats); break;
+        case 2: DimensionalHPDBSCAN<2>(this->m_data, this->m_size).scan(epsilon, minPoints, results, stats); break;
+        case 3: DimensionalHPDBSCAN<3>(this->m_data, this->m_size).scan(epsilon, minPoints, results, stats); break;
+        case 4: DimensionalHPDBSCAN<4>(this->m_data, this->m_size).scan(epsilon, minPoints, results, stats); break;
+    }
 }
 
 /**
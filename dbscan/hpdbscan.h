@@ -3,35 +3,69 @@
 
 #include "points.h"
 #include "rules.h"
+#include "scanstats.h"
 #include "space.h"
 
 #include <stddef.h>
 #include <string>
 
-class HPDBSCAN
+/**
+ * HPDBSCAN on points of D dimensions, all distance and cell computations have a compile time trip count
+ */
+template <size_t D>
+class DimensionalHPDBSCAN
 {    
 protected:
-    Pointz      m_points;
+    Pointz<D>   m_points;
     
     /**
      * Internal Operation\
      */
     void applyRules(const Rules& rules);
     void distributeRules(Rules& rules);
-    Rules localDBSCAN(const Space &space, float epsilon, size_t minPoints);
+    Rules localDBSCAN(const Space<D>& space, float epsilon, size_t minPoints);
     
 public:
-    HPDBSCAN(Coord* points, int npoints, int dimension);
-    void  scan(float epsilon, size_t minPoints, Cluster* results);
+    DimensionalHPDBSCAN(Coord* points, int npoints);
+    void  scan(float epsilon, size_t minPoints, Cluster* results, ScanStats* stats=NULL);
 
      inline size_t size() const
     {
         return this->m_points.size();
     }
 
+    static constexpr size_t dimensions()
+    {
+        return D;
+    }
+};
+
+/**
+ * HPDBSCAN on points with a runtime dimension count, dispatches to the DimensionalHPDBSCAN of that count
+ */
+class HPDBSCAN
+{    
+protected:
+    Coord*      m_data;
+    size_t      m_size;
+    size_t      m_dimensions;
+    
+public:
+    static const size_t MAX_DIMENSIONS = 4;
+
+    /* throws std::invalid_argument for more than MAX_DIMENSIONS dimensions */
+    HPDBSCAN(Coord* points, int npoints, int dimension);
+    /* the phase durations are added to stats if passed */
+    void  scan(float epsilon, size_t minPoints, Cluster* results, ScanStats* stats=NULL);
+
+     inline size_t size() const
+    {
+        return this->m_size;
+    }
+
     inline size_t dimensions() const
     {
-        return this->m_points.dimensions();
+        return this->m_dimensions;
     }
 };
 
@@ -32,11 +32,12 @@ inline size_t power(size_t exp)
 /**
  * Constructor
  */
-Pointz::Pointz(Coord* points, int npoints, int dimension)
+template <size_t D>
+Pointz<D>::Pointz(Coord* points, int npoints)
 {    
-	this->m_points = points;
+    static_assert(sizeof(Point) == D * sizeof(Coord), "the coordinates are viewed as packed D-arrays");
+	this->m_points = reinterpret_cast<Point*>(points);
 	this->m_size = npoints;
-	this->m_dimensions = dimension;
     this->m_cells = new Cell[this->m_size];
 	this->m_initialOrder = new size_t[this->m_size];
 	std::iota(this->m_initialOrder, this->m_initialOrder + this->m_size, 0);
@@ -46,22 +47,24 @@ Pointz::Pointz(Coord* points, int npoints, int dimension)
 /**
  * Operations
  */
-void Pointz::resetClusters(Cluster* clusters)
+template <size_t D>
+void Pointz<D>::resetClusters(Cluster* clusters)
 {
     std::fill(clusters, clusters + this->m_size, NOT_VISITED);
     this->m_clusters = clusters;
 }
 
-void Pointz::sortByOrder(size_t maxDigits, size_t lowerBound, size_t upperBound)
+template <size_t D>
+void Pointz<D>::sortByOrder(size_t maxDigits, size_t lowerBound, size_t upperBound)
 {    
     std::vector<std::vector<size_t> > buckets(maxDigits, std::vector<size_t>(DIGITS));
     size_t size            = upperBound - lowerBound;
-    this->m_points        += lowerBound * this->m_dimensions;
+    this->m_points        += lowerBound;
     this->m_initialOrder  += lowerBound;
     this->m_clusters      += lowerBound;
     Cluster* clusterBuffer = new Cluster[size];
     size_t*  orderBuffer   = new size_t[size];
-    Coord*   pointsBuffer  = new Coord[size * this->m_dimensions];
+    Point*   pointsBuffer  = new Point[size];
     
     for (size_t j = 0; j < maxDigits; ++j)
     {
@@ -100,20 +103,17 @@ void Pointz::sortByOrder(size_t maxDigits, size_t lowerBound, size_t upperBound)
             size_t unit = this->m_initialOrder[i] / base % DIGITS;
             size_t pos  = --buckets[j][unit];
 
-            for (size_t d = 0; d < this->dimensions(); ++d)
-            {
-                pointsBuffer[pos * this->m_dimensions + d] = this->operator [](i)[d];
-            }
+            pointsBuffer[pos]  = this->m_points[i];
             orderBuffer[pos]   = this->m_initialOrder[i];
             clusterBuffer[pos] = this->m_clusters[i];
         }
         std::copy(orderBuffer   , orderBuffer   + size, this->m_initialOrder);
         std::copy(clusterBuffer , clusterBuffer + size, this->m_clusters );
-        std::copy(pointsBuffer  , pointsBuffer  + size * this->m_dimensions, this->m_points);
+        std::copy(pointsBuffer  , pointsBuffer  + size, this->m_points);
     }
     
     
-    this->m_points       -= lowerBound * this->m_dimensions;
+    this->m_points       -= lowerBound;
     this->m_initialOrder -= lowerBound;
     this->m_clusters     -= lowerBound;
     
@@ -122,12 +122,13 @@ void Pointz::sortByOrder(size_t maxDigits, size_t lowerBound, size_t upperBound)
     delete[] clusterBuffer;
 }
 
- void Pointz::sortByCell(const CellIndex& index)
+ template <size_t D>
+ void Pointz<D>::sortByCell(const CellIndex& index)
  {
      // Initialization
      Cell*   cellBuffer  = new Cell[this->m_size];
      size_t* orderBuffer = new size_t[this->m_size];
-     Coord*  pointBuffer = new Coord[this->m_size * this->m_dimensions];
+     Point*  pointBuffer = new Point[this->m_size];
      
      std::unordered_map<size_t, std::atomic<size_t>> counter;
      for (auto pair : index)
@@ -141,10 +142,7 @@ void Pointz::sortByOrder(size_t maxDigits, size_t lowerBound, size_t upperBound)
      {
          const auto& locator = index.find(this->m_cells[i]);
          size_t copyTo       = locator->second.first + (counter[locator->first]++);
-         for (size_t d = 0; d < this->m_dimensions; ++d)
-         {
-             pointBuffer[copyTo * this->m_dimensions + d] = this->m_points[i * this->m_dimensions + d];
-         }
+         pointBuffer[copyTo] = this->m_points[i];
          cellBuffer[copyTo]  = this->m_cells[i];
          orderBuffer[copyTo] = this->m_initialOrder[i];
      }   
@@ -152,17 +150,27 @@ void Pointz::sortByOrder(size_t maxDigits, size_t lowerBound, size_t upperBound)
      // Copy In-Place
      std::copy(cellBuffer,  cellBuffer  + this->m_size, this->m_cells);
      std::copy(orderBuffer, orderBuffer + this->m_size, this->m_initialOrder);
-     std::copy(pointBuffer, pointBuffer + this->m_size * this->m_dimensions, this->m_points);
+     std::copy(pointBuffer, pointBuffer + this->m_size, this->m_points);
      
      delete[] cellBuffer;
+     delete[] orderBuffer;
      delete[] pointBuffer;
 }
 
 /**
  * Destructor
  */
-Pointz::~Pointz()
+template <size_t D>
+Pointz<D>::~Pointz()
 {
     delete[] this->m_cells;
     delete[] this->m_initialOrder;
 }
+
+/**
+ * Instantiations, see HPDBSCAN::MAX_DIMENSIONS
+ */
+template class Pointz<1>;
+template class Pointz<2>;
+template class Pointz<3>;
+template class Pointz<4>;
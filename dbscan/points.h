@@ -5,6 +5,7 @@
 #include "rules.h"
 #include "util.h"
 
+#include <array>
 #include <cmath>
 #include <stddef.h>
 #include <string>
@@ -13,15 +14,21 @@
 #define REORDER true
 #define DATASET "DBSCAN"
 
+/**
+ * Points of D dimensions, the coordinates are viewed in place as an array of D-arrays
+ */
+template <size_t D>
 class Pointz
 {
-    
+public:
+    typedef std::array<Coord, D> Point;
+
+private:
     Cell*    m_cells;
     Cluster* m_clusters;
-    Coord*   m_points;
+    Point*   m_points;
     size_t*  m_initialOrder;
     
-    size_t   m_dimensions;
     size_t   m_size;
     size_t   m_totalSize;
     
@@ -35,7 +42,7 @@ public:
     /**
      * Constructor
      */
-    Pointz(Coord* points, int npoins, int dimensions);
+    Pointz(Coord* points, int npoints);
     
     /**
      * Access
@@ -60,14 +67,14 @@ public:
         return this->m_clusters[index] < 0;
     }
     
-    inline size_t dimensions() const
+    static constexpr size_t dimensions()
     {
-        return this->m_dimensions;
+        return D;
     }
     
-    inline Coord* operator[](size_t index) const
+    inline const Point& operator[](size_t index) const
     {
-        return this->m_points + index * this->m_dimensions;
+        return this->m_points[index];
     }
     
     inline size_t size() const
@@ -0,0 +1,267 @@
+#include "rundbscan.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+/**
+ * Constructors
+ */
+RunDBSCAN::RunDBSCAN(const Run* runs, size_t nruns) :
+    m_runs(runs),
+    m_size(nruns),
+    m_pixels(0),
+    m_firstRow(nruns > 0 ? runs[0].row : 0)
+{
+    for (size_t i = 0; i < this->m_size; ++i)
+    {
+        this->m_pixels += this->m_runs[i].length();
+    }
+
+    // row index, empty rows point to the next filled one
+    const int rows = nruns > 0 ? runs[nruns - 1].row - this->m_firstRow + 1 : 0;
+    this->m_rowRuns.assign(rows + 1, nruns);
+    for (size_t i = nruns; i-- > 0;)
+    {
+        this->m_rowRuns[this->m_runs[i].row - this->m_firstRow] = i;
+    }
+    for (int row = rows - 1; row >= 0; --row)
+    {
+        this->m_rowRuns[row] = std::min(this->m_rowRuns[row], this->m_rowRuns[row + 1]);
+    }
+}
+
+/**
+ * Internal Operations
+ */
+
+/* the number of pixels within epsilon of each pixel of a run as a function of x is a sum of trapezoids,
+   one per run on the rows within reach, which are accumulated from their kinks */
+void RunDBSCAN::computeCores(const std::vector<int>& widths, const size_t minPoints, std::vector<char>& cores) const
+{
+    const int reach = (int)widths.size() - 1;
+    const int rows  = (int)this->m_rowRuns.size() - 1;
+    std::vector<long> kinks;
+
+    size_t offset = 0;
+    for (size_t i = 0; i < this->m_size; ++i)
+    {
+        const Run& run    = this->m_runs[i];
+        const int  length = run.length();
+        const int  row    = run.row - this->m_firstRow;
+        long value = 0;
+        long slope = 0;
+        kinks.assign(length, 0);
+
+        // ramp(x - start) starts to rise after x = start
+        auto ramp = [&](int start, long sign)
+        {
+            if (start <= run.begin)
+            {
+                value += sign * (run.begin - start);
+                slope += sign;
+            }
+            else if (start < run.end)
+            {
+                kinks[start - run.begin] += sign;
+            }
+        };
+
+        for (int other = std::max(row - reach, 0); other <= std::min(row + reach, rows - 1); ++other)
+        {
+            const int width = widths[std::abs(other - row)];
+            for (size_t n = this->m_rowRuns[other]; n < this->m_rowRuns[other + 1]; ++n)
+            {
+                const int first = this->m_runs[n].begin;
+                const int last  = this->m_runs[n].end - 1;
+                if (first > run.end - 1 + width) break;
+                if (last < run.begin - width) continue;
+
+                // |[x - width, x + width] intersected with [first, last]|
+                ramp(first - width - 1, 1);
+                ramp(first + width,    -1);
+                ramp(last  - width,    -1);
+                ramp(last  + width + 1, 1);
+            }
+        }
+
+        for (int x = 0; x < length; ++x)
+        {
+            slope += kinks[x];
+            cores[offset + x] = value >= (long)minPoints;
+            value += slope;
+        }
+        offset += length;
+    }
+}
+
+/* maximal sequences of core pixels within a run, single pixels if neighboring pixels are not within epsilon */
+void RunDBSCAN::computeSegments(const std::vector<char>& cores, const bool split)
+{
+    const int rows = (int)this->m_rowRuns.size() - 1;
+    this->m_segments.clear();
+    this->m_rowSegments.assign(rows + 1, 0);
+
+    size_t offset = 0;
+    for (size_t i = 0; i < this->m_size; ++i)
+    {
+        const Run& run = this->m_runs[i];
+        for (int x = run.begin; x < run.end; ++x)
+        {
+            if (!cores[offset + x - run.begin]) continue;
+
+            Segment segment;
+            segment.row    = run.row;
+            segment.begin  = x;
+            segment.offset = offset + x - run.begin;
+            while (x < run.end && cores[offset + x - run.begin] && !(split && x > segment.begin)) ++x;
+            segment.end = x--;
+            this->m_segments.push_back(segment);
+        }
+        offset += run.length();
+    }
+
+    for (const Segment& segment : this->m_segments)
+    {
+        ++this->m_rowSegments[segment.row - this->m_firstRow + 1];
+    }
+    for (int row = 0; row < rows; ++row)
+    {
+        this->m_rowSegments[row + 1] += this->m_rowSegments[row];
+    }
+}
+
+/* two core segments are density connected if any of their pixels are within epsilon */
+void RunDBSCAN::connectSegments(const std::vector<int>& widths)
+{
+    const int reach = (int)widths.size() - 1;
+    const int rows  = (int)this->m_rowSegments.size() - 1;
+
+    this->m_parents.resize(this->m_segments.size());
+    for (size_t i = 0; i < this->m_parents.size(); ++i)
+    {
+        this->m_parents[i] = i;
+    }
+
+    for (size_t i = 0; i < this->m_segments.size(); ++i)
+    {
+        const Segment& segment = this->m_segments[i];
+        const int      row     = segment.row - this->m_firstRow;
+
+        for (int other = row; other <= std::min(row + reach, rows - 1); ++other)
+        {
+            const int width = widths[other - row];
+            for (size_t n = other == row ? i + 1 : this->m_rowSegments[other]; n < this->m_rowSegments[other + 1]; ++n)
+            {
+                const Segment& neighbor = this->m_segments[n];
+                if (neighbor.begin > segment.end - 1 + width) break;
+                if (neighbor.end - 1 < segment.begin - width) continue;
+
+                this->unite(i, n);
+            }
+        }
+    }
+}
+
+size_t RunDBSCAN::find(size_t segment)
+{
+    while (this->m_parents[segment] != segment)
+    {
+        this->m_parents[segment] = this->m_parents[this->m_parents[segment]];
+        segment = this->m_parents[segment];
+    }
+    return segment;
+}
+
+void RunDBSCAN::unite(size_t first, size_t second)
+{
+    first  = this->find(first);
+    second = this->find(second);
+    if (first == second) return;
+
+    // the root is always the earliest segment, which carries the cluster id
+    if (first < second)
+    {
+        this->m_parents[second] = first;
+    }
+    else
+    {
+        this->m_parents[first] = second;
+    }
+}
+
+/**
+ * Operations
+ */
+void RunDBSCAN::scan(float epsilon, size_t minPoints, Cluster* results, ScanStats* stats)
+{
+    if (this->m_pixels == 0)
+    {
+        return;
+    }
+
+    // half width of the epsilon disc per row offset, the coordinates are integers so that this is exact
+    const float EPS2  = epsilon * epsilon;
+    const int   reach = epsilon >= 0.0f ? (int)std::floor(epsilon) : -1;
+    std::vector<int> widths(reach + 1);
+    for (int dy = 0; dy <= reach; ++dy)
+    {
+        int width = (int)std::sqrt(std::max(EPS2 - (float)(dy * dy), 0.0f));
+        while ((float)((width + 1) * (width + 1) + dy * dy) <= EPS2) ++width;
+        while (width > 0 && (float)(width * width + dy * dy) > EPS2) --width;
+        widths[dy] = width;
+    }
+    if (widths.empty())
+    {
+        std::fill(results, results + this->m_pixels, 0);
+        return;
+    }
+
+    PhaseClock clock;
+    std::vector<char> cores(this->m_pixels);
+    this->computeCores(widths, minPoints, cores);
+    if (stats) stats->local += clock.lap();
+    this->computeSegments(cores, widths[0] < 1);
+    if (stats) stats->index += clock.lap();
+    this->connectSegments(widths);
+    if (stats) stats->merge += clock.lap();
+
+    // cluster ids like HPDBSCAN - positive and unique, noise is zero
+    for (size_t i = 0; i < this->m_segments.size(); ++i)
+    {
+        const Segment& segment = this->m_segments[i];
+        const Cluster  cluster = (Cluster)this->m_segments[this->find(i)].offset + 1;
+        std::fill(results + segment.offset, results + segment.offset + (segment.end - segment.begin), -cluster);
+    }
+
+    // border points join the smallest cluster with a core point within epsilon
+    const int rows   = (int)this->m_rowSegments.size() - 1;
+    size_t    offset = 0;
+    for (size_t i = 0; i < this->m_size; ++i)
+    {
+        const Run& run = this->m_runs[i];
+        const int  row = run.row - this->m_firstRow;
+        for (int x = run.begin; x < run.end; ++x)
+        {
+            const size_t index = offset + x - run.begin;
+            if (cores[index]) continue;
+
+            Cluster cluster = NOISE;
+            for (int other = std::max(row - reach, 0); other <= std::min(row + reach, rows - 1); ++other)
+            {
+                const int width = widths[std::abs(other - row)];
+                for (size_t n = this->m_rowSegments[other]; n < this->m_rowSegments[other + 1]; ++n)
+                {
+                    const Segment& neighbor = this->m_segments[n];
+                    if (neighbor.begin > x + width) break;
+                    if (neighbor.end - 1 < x - width) continue;
+
+                    cluster = std::min(cluster, -results[neighbor.offset]);
+                }
+            }
+            results[index] = cluster == NOISE ? 0 : cluster;
+        }
+        offset += run.length();
+    }
+    if (stats) stats->label += clock.lap();
+}
@@ -0,0 +1,79 @@
+#ifndef RUNDBSCAN_H
+#define	RUNDBSCAN_H
+
+#include "constants.h"
+#include "scanstats.h"
+
+#include <stddef.h>
+#include <vector>
+
+/**
+ * Horizontal foreground segment [begin, end) of an image row
+ */
+struct Run
+{
+    int row;
+    int begin;
+    int end;
+
+    Run() : row(0), begin(0), end(0) {}
+    Run(int y, int first, int last) : row(y), begin(first), end(last) {}
+
+    inline int length() const
+    {
+        return this->end - this->begin;
+    }
+};
+
+typedef std::vector<Run> Runs;
+
+/**
+ * DBSCAN on the pixels of a run-length encoded 2-D mask with euclidean distance.
+ * The results are equivalent to HPDBSCAN on the pixel coordinates: core points
+ * are labeled negative, border points positive and noise zero. Core status is
+ * derived from run overlaps and clusters are formed from runs of core pixels,
+ * so the work grows with the number of runs instead of the number of pixels.
+ */
+class RunDBSCAN
+{
+protected:
+    struct Segment
+    {
+        int    row;
+        int    begin;
+        int    end;
+        size_t offset; // index of the first pixel
+    };
+
+    const Run*           m_runs;
+    size_t               m_size;
+    size_t               m_pixels;
+
+    int                  m_firstRow;
+    std::vector<size_t>  m_rowRuns;     // first run of each row
+    std::vector<size_t>  m_rowSegments; // first core segment of each row
+    std::vector<Segment> m_segments;
+    std::vector<size_t>  m_parents;
+
+    /**
+     * Internal Operations
+     */
+    void   computeCores(const std::vector<int>& widths, size_t minPoints, std::vector<char>& cores) const;
+    void   computeSegments(const std::vector<char>& cores, bool split);
+    void   connectSegments(const std::vector<int>& widths);
+    size_t find(size_t segment);
+    void   unite(size_t first, size_t second);
+
+public:
+    /* the runs must be sorted by row and column and must not overlap */
+    RunDBSCAN(const Run* runs, size_t nruns);
+    /* results must hold one label per pixel, the pixels are ordered like the runs, the phase durations are added to stats if passed */
+    void scan(float epsilon, size_t minPoints, Cluster* results, ScanStats* stats=NULL);
+
+    inline size_t size() const
+    {
+        return this->m_pixels;
+    }
+};
+
+#endif	// RUNDBSCAN_H
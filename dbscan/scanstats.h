@@ -0,0 +1,41 @@
+#ifndef SCANSTATS_H
+#define	SCANSTATS_H
+
+#include <chrono>
+
+/**
+ * Optional breakdown of DBSCAN scans into their phases. The wall clock
+ * milliseconds are added up over all scans the stats are passed to, so
+ * that a caller can sum the scans of a frame and report them once.
+ */
+struct ScanStats
+{
+    double index; // spatial index - HPDBSCAN space, RunDBSCAN core segments
+    double local; // core point detection
+    double merge; // cluster merging - HPDBSCAN rules, RunDBSCAN segment union
+    double label; // result labels - HPDBSCAN sort, RunDBSCAN border points
+
+    ScanStats() : index(0.0), local(0.0), merge(0.0), label(0.0) {}
+};
+
+/**
+ * Measures consecutive phases, each lap returns the milliseconds since the previous one
+ */
+class PhaseClock
+{
+protected:
+    std::chrono::steady_clock::time_point m_last;
+
+public:
+    PhaseClock() : m_last(std::chrono::steady_clock::now()) {}
+
+    inline double lap()
+    {
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        double elapsed = std::chrono::duration<double, std::milli>(now - this->m_last).count();
+        this->m_last = now;
+        return elapsed;
+    }
+};
+
+#endif	// SCANSTATS_H
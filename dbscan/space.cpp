@@ -16,45 +16,27 @@ void mergeCells(CellCounter& omp_in, CellCounter& omp_out)
     }
 }
 
-void vectorMin(std::vector<Coord>& omp_in, std::vector<Coord>& omp_out)
-{
-    size_t index = -1;
-    for (auto& coordinate : omp_out)
-    {
-        coordinate = std::min(coordinate, omp_in[++index]);
-    }
-}
-
-void vectorMax(std::vector<Coord>& omp_in, std::vector<Coord>& omp_out)
-{
-    size_t index = -1;
-    for (auto& coordinate : omp_out)
-    {
-        coordinate = std::max(coordinate, omp_in[++index]);
-    }
-}
-
 #pragma omp declare reduction(mergeCells: CellCounter: mergeCells(omp_in, omp_out)) initializer(omp_priv(CellCounter()))
-#pragma omp declare reduction(vectorMax: std::vector<Coord>: vectorMax(omp_in, omp_out)) initializer(omp_priv(omp_orig))
-#pragma omp declare reduction(vectorMin: std::vector<Coord>: vectorMin(omp_in, omp_out)) initializer(omp_priv(omp_orig))
 
-Space::Space(Pointz& points, float epsilon) :
+template <size_t D>
+Space<D>::Space(Pointz<D>& points, float epsilon) :
     m_points(points),
     m_total(1),
-    m_lastCell(0),
-    m_cells(std::vector<size_t>(points.dimensions(),  0)),
-    m_maximum(std::vector<Coord>(points.dimensions(), -std::numeric_limits<Coord>::max())),
-    m_minimum(std::vector<Coord>(points.dimensions(),  std::numeric_limits<Coord>::max())),
-    m_swapDims(std::vector<size_t>(points.dimensions()))
+    m_lastCell(0)
 {
+    this->m_cells.fill(0);
+    this->m_maximum.fill(-std::numeric_limits<Coord>::max());
+    this->m_minimum.fill( std::numeric_limits<Coord>::max());
     std::iota(this->m_swapDims.begin(), this->m_swapDims.end(), 0);
     this->computeDimensions(epsilon);
     CellCounter cellCounter = this->computeCells(epsilon);
     this->computeIndex(cellCounter);
     this->m_points.sortByCell(this->m_cellIndex);
+    this->computeNeighborhoods();
 }
 
-CellCounter Space::computeCells(float epsilon)
+template <size_t D>
+CellCounter Space<D>::computeCells(float epsilon)
 {
     CellCounter cellCounter;
     //#pragma omp parallel for reduction(mergeCells: cellCounter)
@@ -78,26 +60,36 @@ CellCounter Space::computeCells(float epsilon)
     return cellCounter;
 }  
 
-void Space::computeDimensions(float epsilon)
+template <size_t D>
+void Space<D>::computeDimensions(float epsilon)
 {
-    const size_t dimensions = this->m_points.dimensions();
-    auto& maximum = this->m_maximum;
-    auto& minimum = this->m_minimum;
-    
-    #pragma omp parallel for reduction(vectorMin: minimum) reduction(vectorMax: maximum)
-    for (size_t iter = 0; iter < this->m_points.size(); ++iter)
+    // bounds per thread, merged afterwards
+    #pragma omp parallel
     {
-        const auto& point = this->m_points[iter];
-        for (size_t d = 0; d < dimensions; ++d)
+        Point minimum = this->m_minimum;
+        Point maximum = this->m_maximum;
+
+        #pragma omp for nowait
+        for (size_t iter = 0; iter < this->m_points.size(); ++iter)
         {
-            const Coord& coordinate = point[d];
-            minimum[d] = std::min(minimum[d], coordinate);
-            maximum[d] = std::max(maximum[d], coordinate);
+            const Point& point = this->m_points[iter];
+            for (size_t d = 0; d < D; ++d)
+            {
+                minimum[d] = std::min(minimum[d], point[d]);
+                maximum[d] = std::max(maximum[d], point[d]);
+            }
+        }
+
+        #pragma omp critical
+        for (size_t d = 0; d < D; ++d)
+        {
+            this->m_minimum[d] = std::min(this->m_minimum[d], minimum[d]);
+            this->m_maximum[d] = std::max(this->m_maximum[d], maximum[d]);
         }
     }
 
     // compute cell count
-    for (size_t d = 0; d < this->m_cells.size(); ++d)
+    for (size_t d = 0; d < D; ++d)
     {
         size_t cells     = (size_t) ceil((this->m_maximum[d] - this->m_minimum[d]) / epsilon) + 1;
         this->m_cells[d] = cells;
@@ -108,7 +100,8 @@ void Space::computeDimensions(float epsilon)
     this->m_lastCell = this->m_total;
 }
 
-void Space::computeIndex(CellCounter& cellCounter)
+template <size_t D>
+void Space<D>::computeIndex(CellCounter& cellCounter)
 {
     // setup index
     size_t accumulator = 0;
@@ -124,7 +117,8 @@ void Space::computeIndex(CellCounter& cellCounter)
     m_cellIndex[this->m_lastCell].second = 0;
 }
 
-void Space::swapDimensions()
+template <size_t D>
+void Space<D>::swapDimensions()
 {
     const auto& dims = this->m_cells;
     std::sort(this->m_swapDims.begin(), this->m_swapDims.end(), [dims](size_t a, size_t b)
@@ -137,93 +131,158 @@ void Space::swapDimensions()
  * Operations
  */
 
-std::vector<size_t> Space::getNeighbors(const size_t cellId) const
+/* galloping search from the index of a nearby occupied cell, the neighbor lines are close to the cell itself */
+template <size_t D>
+size_t Space<D>::firstPoint(const Cell cellId, const size_t hint) const
+{
+    const std::vector<Cell>& cells = this->m_occupied;
+    size_t lower = hint;
+    size_t upper = hint;
+    size_t step  = 1;
+
+    if (cells[hint] < cellId)
+    {
+        lower = upper = hint + 1;
+        while (upper < cells.size() && cells[upper] < cellId)
+        {
+            lower  = upper + 1;
+            upper += step;
+            step  *= 2;
+        }
+        upper = std::min(upper, cells.size());
+    }
+    else
+    {
+        while (lower > 0 && cells[lower - 1] >= cellId)
+        {
+            upper = lower - 1;
+            lower = lower > step ? lower - step : 0;
+            step *= 2;
+        }
+    }
+
+    const auto found = std::lower_bound(cells.begin() + lower, cells.begin() + upper, cellId);
+    return this->m_starts[found - cells.begin()];
+}
+
+template <size_t D>
+typename Space<D>::Neighborhood Space<D>::computeNeighborhood(const size_t occupied) const
 {    
-    const CellIndex& cellIdx = this->m_cellIndex;
-    
-    std::vector<size_t> neighborCells;
-    neighborCells.reserve(std::pow(3, m_points.dimensions()));
-    neighborCells.push_back(cellId);
+    // the neighbor cells along the fastest dimension have consecutive numbers, so each line of three
+    // cells is one contiguous range of the points sorted by cell and only the lines are enumerated
+    const Cell cellId = this->m_occupied[occupied];
+    std::array<size_t, Space<D>::neighborCells() / 3> lines;
+    size_t lineCount = 0;
+    lines[lineCount++] = cellId;
 
-    size_t lowerSpace     = 1;
-    size_t currentSpace   = 1;
-    size_t numberOfPoints = cellIdx.find(cellId)->second.second;
+    const size_t fastest      = this->m_cells[this->m_swapDims[0]];
+    size_t       lowerSpace   = fastest;
+    size_t       currentSpace = fastest;
     
     // here be dragons!
-    for (size_t d : this->m_swapDims)
+    for (size_t k = 1; k < D; ++k)
     {
-        currentSpace *= this->m_cells[d];
+        currentSpace *= this->m_cells[this->m_swapDims[k]];
         
-        for (size_t i = 0, end = neighborCells.size(); i < end; ++i)
+        for (size_t i = 0, end = lineCount; i < end; ++i)
         {
-            const size_t current = neighborCells[i];
+            const size_t current = lines[i];
             // check "left" neighbor - a.k.a the cell in the current dimension that has a lower number
-            const long int left = current - lowerSpace;
-            auto found    = cellIdx.find(left);
             if (current % currentSpace >= lowerSpace)
             {
-                neighborCells.push_back(left);
-                numberOfPoints += found != cellIdx.end() ? found->second.second : 0;
+                lines[lineCount++] = current - lowerSpace;
             }
 
             // check "right" neighbor - a.k.a the cell in the current dimension that has a higher number
-            const long int right = current + lowerSpace;
-            found = cellIdx.find(right);
             if (current % currentSpace < currentSpace - lowerSpace)
             {
-                neighborCells.push_back(right);
-                numberOfPoints += found != cellIdx.end() ? found->second.second : 0;
+                lines[lineCount++] = current + lowerSpace;
             }
         }
         
         lowerSpace = currentSpace;
     }
 
-    std::vector<size_t> neighborPoints;
-    neighborPoints.reserve(numberOfPoints);
-    
-    for (size_t neighborCell : neighborCells)
+    Neighborhood neighborhood;
+    neighborhood.count  = 0;
+    neighborhood.points = 0;
+    for (size_t i = 0; i < lineCount; ++i)
     {
-        const auto found = cellIdx.find(neighborCell);
-        if (found == cellIdx.end())
+        const size_t line  = lines[i];
+        const size_t first = line - (line % fastest >= 1 ? 1 : 0);
+        const size_t last  = line + (line % fastest < fastest - 1 ? 1 : 0);
+        const Range  range(this->firstPoint(first, occupied), this->firstPoint(last + 1, occupied));
+        if (range.first == range.second)
         {
             continue;
         }
-        
-        const std::pair<size_t, size_t>& locator = found->second;
-        neighborPoints.resize(neighborPoints.size() + locator.second);
-        auto end = neighborPoints.end();
-        std::iota(end - locator.second, end, locator.first);
+        neighborhood.ranges[neighborhood.count++] = range;
+        neighborhood.points += range.second - range.first;
+    }
+
+    // lines without points in between do not break the ranges apart, insertion sort of the few ranges
+    for (size_t i = 1; i < neighborhood.count; ++i)
+    {
+        const Range range = neighborhood.ranges[i];
+        size_t j = i;
+        for (; j > 0 && neighborhood.ranges[j - 1].first > range.first; --j)
+        {
+            neighborhood.ranges[j] = neighborhood.ranges[j - 1];
+        }
+        neighborhood.ranges[j] = range;
+    }
+    size_t merged = 0;
+    for (size_t i = 1; i < neighborhood.count; ++i)
+    {
+        if (neighborhood.ranges[i].first == neighborhood.ranges[merged].second)
+        {
+            neighborhood.ranges[merged].second = neighborhood.ranges[i].second;
+        }
+        else
+        {
+            neighborhood.ranges[++merged] = neighborhood.ranges[i];
+        }
     }
+    neighborhood.count = std::min(neighborhood.count, merged + 1);
 
-    return neighborPoints;
+    return neighborhood;
 }
 
-size_t Space::regionQuery(const size_t pointIndex, const std::vector<size_t>& neighborPoints, const float EPS2, std::vector<size_t>& minPointsArea) const
+template <size_t D>
+void Space<D>::computeNeighborhoods()
 {
-    const Coord* point = this->m_points[pointIndex];
-    // this MUST be a positive number so that atomicMin will result in correct result with set corePoint bit
-    size_t clusterId   = pointIndex + 1;
-    
-    for (size_t neighbor: neighborPoints)
+    // occupied cells and their first points, the start after the last cell is the number of points
+    this->m_occupied.reserve(this->m_cellIndex.size());
+    this->m_starts.reserve(this->m_cellIndex.size() + 1);
+    for (const auto& cell : this->m_cellIndex)
     {
-        float offset            = 0.0f;
-        const Coord* otherPoint = this->m_points[neighbor];
-
-        for (size_t d = 0; d < this->m_points.dimensions(); ++d)
+        if (cell.second.second > 0)
         {
-            offset += std::pow(otherPoint[d] - point[d], 2);
-        }
-        if (offset <= EPS2)
-        {
-            minPointsArea.push_back(neighbor);  
-            size_t neighborCluster = this->m_points.cluster(neighbor);
-            if (neighborCluster != NOT_VISITED && this->m_points.corePoint(neighbor))
-            {
-                clusterId = std::min(clusterId, neighborCluster);
-            }
+            this->m_occupied.push_back(cell.first);
+            this->m_starts.push_back(cell.second.first);
         }
     }
+    this->m_starts.push_back(this->m_points.size());
+
+    this->m_neighborhoods.resize(this->m_occupied.size());
+    #pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < this->m_occupied.size(); ++i)
+    {
+        this->m_neighborhoods[i] = this->computeNeighborhood(i);
+    }
+}
 
-    return clusterId;
+template <size_t D>
+const typename Space<D>::Neighborhood& Space<D>::getNeighbors(const Cell cellId) const
+{
+    const auto found = std::lower_bound(this->m_occupied.begin(), this->m_occupied.end(), cellId);
+    return this->m_neighborhoods[found - this->m_occupied.begin()];
 }
+
+/**
+ * Instantiations, see HPDBSCAN::MAX_DIMENSIONS
+ */
+template class Space<1>;
+template class Space<2>;
+template class Space<3>;
+template class Space<4>;
@@ -5,21 +5,53 @@
 #include "points.h"
 
 #include <stddef.h>
+#include <array>
 #include <map>
 #include <vector>
 
+/**
+ * Cell grid of edge length epsilon over points of D dimensions
+ */
+template <size_t D>
 class Space {
-    Pointz&             m_points;
+public:
+    typedef typename Pointz<D>::Point Point;
+    typedef std::array<size_t, D>     Dimensions;
+    typedef std::pair<size_t, size_t> Range; // [begin, end) of point indices
+
+    /* the cell itself and its direct neighbors in every dimension */
+    static constexpr size_t neighborCells(size_t dimensions = D)
+    {
+        return dimensions == 0 ? 1 : 3 * neighborCells(dimensions - 1);
+    }
+
+    /**
+     * Points of a cell and its neighbor cells. The points are sorted by cell, so these are a few contiguous
+     * ranges - the cells next to each other in the fastest dimension merge into one.
+     */
+    struct Neighborhood
+    {
+        std::array<Range, neighborCells()> ranges;
+        size_t                             count;  // used ranges
+        size_t                             points; // total size of the ranges
+    };
+
+private:
+    Pointz<D>&          m_points;
     
     CellIndex           m_cellIndex;
     
     size_t              m_total;
     size_t              m_lastCell;
     
-    std::vector<size_t> m_cells;
-    std::vector<Coord>  m_maximum; 
-    std::vector<Coord>  m_minimum;    
-    std::vector<size_t> m_swapDims;
+    Dimensions          m_cells;
+    Point               m_maximum; 
+    Point               m_minimum;    
+    Dimensions          m_swapDims;
+
+    std::vector<Cell>         m_occupied;      // cells with points, ascending
+    std::vector<size_t>       m_starts;        // first point of each occupied cell and the point count
+    std::vector<Neighborhood> m_neighborhoods; // one per occupied cell
     
     
     /**
@@ -30,9 +62,12 @@ class Space {
     void computeDimensions(float epsilon);
     void computeIndex(CellCounter& counter);
     void swapDimensions();
+    void computeNeighborhoods();
+    size_t firstPoint(const Cell cellId, const size_t hint) const; // of the first occupied cell not below cellId
+    Neighborhood computeNeighborhood(const size_t occupied) const;
     
 public:
-    Space(Pointz& points, float epsilon);
+    Space(Pointz<D>& points, float epsilon);
     
     /**
      * Access 
@@ -42,7 +77,7 @@ public:
         return this->m_cellIndex;
     }
     
-    inline const std::vector<size_t>& cells() const
+    inline const Dimensions& cells() const
     {
         return this->m_cells;
     }
@@ -52,7 +87,7 @@ public:
         return this->m_cells[dimension];
     }
     
-    inline const std::vector<Coord>& max() const
+    inline const Point& max() const
     {
         return this->m_maximum;
     }
@@ -63,7 +98,7 @@ public:
     
     }
     
-    inline const std::vector<Coord>& min() const
+    inline const Point& min() const
     {
         return this->m_minimum;
     }
@@ -81,8 +116,42 @@ public:
     /**
      * Operations
      */
-    std::vector<size_t> getNeighbors(const size_t cellId) const;
-    size_t regionQuery(const size_t pointIndex, const std::vector<size_t>& neighborPoints, const float EPS2, std::vector<size_t>& minPointsArea) const;
+    /* cached neighborhood of an occupied cell */
+    const Neighborhood& getNeighbors(const Cell cellId) const;
+
+    /* the distance loop has a compile time trip count, so it is unrolled in the local DBSCAN loop */
+    inline size_t regionQuery(const size_t pointIndex, const Neighborhood& neighbors, const float EPS2, std::vector<size_t>& minPointsArea) const
+    {
+        const Point& point = this->m_points[pointIndex];
+        // this MUST be a positive number so that atomicMin will result in correct result with set corePoint bit
+        size_t clusterId   = pointIndex + 1;
+        
+        for (size_t r = 0; r < neighbors.count; ++r)
+        {
+            for (size_t neighbor = neighbors.ranges[r].first; neighbor < neighbors.ranges[r].second; ++neighbor)
+            {
+                float offset            = 0.0f;
+                const Point& otherPoint = this->m_points[neighbor];
+
+                for (size_t d = 0; d < D; ++d)
+                {
+                    const float delta = otherPoint[d] - point[d];
+                    offset += delta * delta;
+                }
+                if (offset <= EPS2)
+                {
+                    minPointsArea.push_back(neighbor);  
+                    size_t neighborCluster = this->m_points.cluster(neighbor);
+                    if (neighborCluster != NOT_VISITED && this->m_points.corePoint(neighbor))
+                    {
+                        clusterId = std::min(clusterId, neighborCluster);
+                    }
+                }
+            }
+        }
+
+        return clusterId;
+    }
 };
 
 #endif	// SPACE_H
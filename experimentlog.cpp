@@ -0,0 +1,117 @@
+#include "experimentlog.h"
+
+#include <cstring>
+#include <sys/stat.h>
+
+static_assert(sizeof(RoundRecord)   == 24, "unexpected padding in RoundRecord");
+static_assert(sizeof(VialRecord)    == 24, "unexpected padding in VialRecord");
+static_assert(sizeof(ClusterRecord) == 24, "unexpected padding in ClusterRecord");
+
+ExperimentLog::ExperimentLog()
+:
+round(0)
+{
+
+}
+
+/* opens a record file for appending, new files get the header first */
+bool ExperimentLog::openFile(ResultWriter& writer, const std::string& path, const char* magic, uint32_t recordSize)
+{
+    struct stat info;
+    bool exists = stat(path.c_str(), &info) == 0 && info.st_size > 0;
+
+    if (!writer.open(path)) return false;
+    if (!exists)
+    {
+        char header[16] = {0};
+        std::memcpy(header, magic, 8);
+        uint32_t version = VERSION;
+        std::memcpy(header + 8,  &version,    sizeof(version));
+        std::memcpy(header + 12, &recordSize, sizeof(recordSize));
+        writer.write(header, sizeof(header));
+    }
+    return true;
+}
+
+bool ExperimentLog::open(const std::string& directory)
+{
+    this->round = 0;
+    return openFile(this->rounds,   directory + "/rounds.bin",   "FLYROUND", sizeof(RoundRecord))
+        && openFile(this->vials,    directory + "/vials.bin",    "FLYVIALS", sizeof(VialRecord))
+        && openFile(this->clusters, directory + "/clusters.bin", "FLYCLUST", sizeof(ClusterRecord));
+}
+
+bool ExperimentLog::isOpen() const
+{
+    return this->rounds.isOpen() && this->vials.isOpen() && this->clusters.isOpen();
+}
+
+void ExperimentLog::close()
+{
+    this->rounds.close();
+    this->vials.close();
+    this->clusters.close();
+}
+
+void ExperimentLog::write(double time, const Vials& vials, int pixelsPerFly)
+{
+    if (!this->isOpen()) return;
+
+    RoundRecord roundRecord;
+    roundRecord.time         = time;
+    roundRecord.round        = this->round;
+    roundRecord.vials        = (uint32_t)vials.size();
+    roundRecord.pixelsPerFly = (float)pixelsPerFly;
+    roundRecord.flies        = 0;
+
+    for (size_t i = 0; i < vials.size(); ++i)
+    {
+        const Vial& vial = vials[i];
+
+        VialRecord vialRecord;
+        vialRecord.round    = this->round;
+        vialRecord.vial     = (uint16_t)i;
+        vialRecord.clusters = 0;
+        vialRecord.flies    = vial.flyCount;
+        vialRecord.noise    = 0;
+        vialRecord.x        = (float)vial.center.x;
+        vialRecord.y        = (float)vial.center.y;
+
+        for (const auto& size : vial.clusterSizes)
+        {
+            if (size.first == 0)
+            {
+                vialRecord.noise = size.second;
+                continue;
+            }
+
+            auto center = vial.clusterCenters.find(size.first);
+            ClusterRecord clusterRecord;
+            clusterRecord.round    = this->round;
+            clusterRecord.vial     = (uint16_t)i;
+            clusterRecord.reserved = 0;
+            clusterRecord.label    = size.first;
+            clusterRecord.size     = (uint32_t)size.second;
+            clusterRecord.x        = center != vial.clusterCenters.end() ? center->second.x : 0.0f;
+            clusterRecord.y        = center != vial.clusterCenters.end() ? center->second.y : 0.0f;
+            this->clusters.write(reinterpret_cast<const char*>(&clusterRecord), sizeof(clusterRecord));
+            ++vialRecord.clusters;
+        }
+        this->vials.write(reinterpret_cast<const char*>(&vialRecord), sizeof(vialRecord));
+        roundRecord.flies += vial.flyCount;
+    }
+    this->rounds.write(reinterpret_cast<const char*>(&roundRecord), sizeof(roundRecord));
+
+    this->rounds.endRound();
+    this->vials.endRound();
+    this->clusters.endRound();
+    ++this->round;
+}
+
+/* setters */
+void ExperimentLog::setSyncInterval(int value)
+{
+    this->rounds.setSyncInterval(value);
+    this->vials.setSyncInterval(value);
+    this->clusters.setSyncInterval(value);
+}
@@ -0,0 +1,70 @@
+#ifndef EXPERIMENTLOG_H
+#define EXPERIMENTLOG_H
+
+#include <cstdint>
+#include <string>
+
+#include "resultwriter.h"
+#include "vials.h"
+
+/* Fixed-width binary records, every file starts with a 16 byte header (8 byte magic, version, record size) */
+/* and can be memory-mapped as an array of records right after it, see tools/readlog.py */
+struct RoundRecord
+{
+    double   time;         // seconds since experiment start
+    uint32_t round;
+    uint32_t vials;
+    float    pixelsPerFly;
+    uint32_t flies;
+};
+
+struct VialRecord
+{
+    uint32_t round;
+    uint16_t vial;
+    uint16_t clusters;     // without noise
+    int32_t  flies;
+    int32_t  noise;        // pixels not assigned to any cluster
+    float    x;            // vial center
+    float    y;
+};
+
+struct ClusterRecord
+{
+    uint32_t round;
+    uint16_t vial;
+    uint16_t reserved;
+    int32_t  label;
+    uint32_t size;         // pixels
+    float    x;            // centroid
+    float    y;
+};
+
+/* Binary per-round, per-vial and per-cluster experiment log written next to results.csv */
+class ExperimentLog
+{
+protected:
+    ResultWriter rounds;
+    ResultWriter vials;
+    ResultWriter clusters;
+    uint32_t     round;
+
+    static bool openFile(ResultWriter& writer, const std::string& path, const char* magic, uint32_t recordSize);
+
+public:
+    static const uint32_t VERSION = 1;
+
+    ExperimentLog();
+
+    bool open(const std::string& directory);
+    bool isOpen() const;
+    void close();
+
+    /* Appends the counted vials of one round */
+    void write(double time, const Vials& vials, int pixelsPerFly);
+
+    /* Setters */
+    void setSyncInterval(int value);
+};
+
+#endif // EXPERIMENTLOG_H
@@ -1,3 +1,5 @@
+#include <fstream>
+#include <iterator>
 #include <sstream>
 
 #include <QDir>
@@ -24,6 +26,16 @@ bool FileCam::getImage(cv::Mat& image)
 
     std::stringstream imagePath;
     imagePath << this->path << "/" << this->images.takeFirst().toStdString();
-    image = cv::imread(imagePath.str());
+    std::ifstream input(imagePath.str(), std::ios::binary);
+    this->encoded.assign(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>());
+    image = this->encoded.empty() ? cv::Mat() : cv::imdecode(this->encoded, cv::IMREAD_COLOR);
+    return true;
+}
+
+bool FileCam::getEncoded(std::vector<uchar>& data)
+{
+    if (this->encoded.empty()) return false;
+
+    data = this->encoded;
     return true;
 }
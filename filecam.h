@@ -2,6 +2,7 @@
 #define FILECAM_H
 
 #include <string>
+#include <vector>
 
 #include <QStringList>
 #include <opencv2/opencv.hpp>
@@ -14,10 +15,12 @@ class FileCam : public Cam
 private:
     const std::string path;
     QStringList       images;
+    std::vector<uchar> encoded;
 
 public:
     FileCam(const std::string& folder);
     virtual bool getImage(cv::Mat& image);
+    virtual bool getEncoded(std::vector<uchar>& data);
 };
 
 #endif // FILECAM_H
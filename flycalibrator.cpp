@@ -0,0 +1,100 @@
+#include "flycalibrator.h"
+
+#include <algorithm>
+#include <cmath>
+
+FlyCalibrator::FlyCalibrator()
+:
+histogram(MAX_SIZE / BIN_WIDTH, 0),
+sums(MAX_SIZE / BIN_WIDTH, 0),
+samples(0)
+{
+
+}
+
+/* returns the bin with the most (box-smoothed) entries within [lower, upper) */
+int FlyCalibrator::findPeak(int lower, int upper) const
+{
+    int bins  = (int)this->histogram.size();
+    int peak  = -1;
+    int count = 0;
+
+    lower = std::max(lower, 0);
+    upper = std::min(upper, bins);
+    for (int i = lower; i < upper; ++i)
+    {
+        int smoothed = this->histogram[i];
+        if (i > 0)        smoothed += this->histogram[i - 1];
+        if (i < bins - 1) smoothed += this->histogram[i + 1];
+
+        if (smoothed > count)
+        {
+            count = smoothed;
+            peak  = i;
+        }
+    }
+    return peak;
+}
+
+void FlyCalibrator::add(const Vials& vials)
+{
+    for (const Vial& vial : vials)
+    {
+        for (auto size : vial.clusterSizes)
+        {
+            if (size.first == 0) continue; // noise
+            this->add(size.second);
+        }
+    }
+}
+
+void FlyCalibrator::add(int clusterSize)
+{
+    if (clusterSize <= 0 || clusterSize >= MAX_SIZE) return;
+
+    int bin = clusterSize / BIN_WIDTH;
+    ++this->histogram[bin];
+    this->sums[bin] += clusterSize;
+    ++this->samples;
+}
+
+/* single fly mode detection - the most frequent cluster size is a single fly, unless there is a substantial peak at half its size */
+int FlyCalibrator::estimate() const
+{
+    if (this->samples < MIN_SAMPLES) return 0;
+
+    int bins = (int)this->histogram.size();
+    int peak = this->findPeak(0, bins);
+    if (peak < 0) return 0;
+
+    // crowded vials - the dominant peak might be two flies sitting together
+    int half = this->findPeak((int)(peak * 0.4), (int)(peak * 0.6) + 1);
+    if (half > 0 && 3 * this->histogram[half] >= this->histogram[peak])
+    {
+        peak = half;
+    }
+
+    // refine with the mean cluster size around the peak
+    long count = 0;
+    long total = 0;
+    for (int i = (int)(peak * 0.7); i <= std::min((int)std::ceil(peak * 1.3), bins - 1); ++i)
+    {
+        count += this->histogram[i];
+        total += this->sums[i];
+    }
+    if (count == 0) return 0;
+
+    return (int)std::lround((double)total / (double)count);
+}
+
+int FlyCalibrator::getSamples() const
+{
+    return this->samples;
+}
+
+void FlyCalibrator::reset()
+{
+    std::fill(this->histogram.begin(), this->histogram.end(), 0);
+    std::fill(this->sums.begin(), this->sums.end(), 0);
+    this->samples = 0;
+}
@@ -0,0 +1,35 @@
+#ifndef FLYCALIBRATOR_H
+#define FLYCALIBRATOR_H
+
+#include <vector>
+
+#include "vials.h"
+
+/* Estimates the pixels per fly from a histogram of the cluster sizes seen across vials and rounds */
+class FlyCalibrator
+{
+protected:
+    std::vector<int>  histogram;
+    std::vector<long> sums;
+    int               samples;
+
+    int findPeak(int lower, int upper) const;
+
+public:
+    static const int BIN_WIDTH   = 4;    // px
+    static const int MAX_SIZE    = 4096; // px
+    static const int MIN_SAMPLES = 50;   // clusters
+
+    FlyCalibrator();
+
+    /* Adds the cluster sizes of the passed (already counted) vials to the histogram */
+    void add(const Vials& vials);
+    void add(int clusterSize);
+
+    /* Returns the estimated pixels per fly or zero if there are not enough samples yet */
+    int  estimate() const;
+    int  getSamples() const;
+    void reset();
+};
+
+#endif // FLYCALIBRATOR_H
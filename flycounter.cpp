@@ -1,13 +1,19 @@
 #include "flycounter.h"
 
-#include "dbscan/hpdbscan.h"
+#include <exception>
+#include <stdexcept>
+
+#include "dbscan/rundbscan.h"
+#include "sparsemask.h"
 
 FlyCounter::FlyCounter()
 :
 epsilon(0),
 minPoints(0),
 pixelsPerFly(0),
-threshold(0)
+threshold(0),
+thresholdMode(GLOBAL),
+thresholdK(2.0f)
 {
 
 }
@@ -65,15 +71,121 @@ int FlyCounter::getThreshold()
     return this->threshold;
 }
 
+int FlyCounter::getThresholdMode()
+{
+    return this->thresholdMode;
+}
+
+float FlyCounter::getThresholdK()
+{
+    return this->thresholdK;
+}
+
 
 /* Methods for external usage*/
 int FlyCounter::count(const cv::Mat& img, Vials& vials)
 {
-    cv::Mat thresh = this->generateThresholdImage(img);
-    int num_flies = countFlies(thresh, vials);
+    this->thresholdVials(img, vials);
+    int num_flies = countFlies(vials);
     return num_flies;
 }
 
+/* the stacks are N x H x W x 3 (or 4) uint8 arrays, anything else would only fail inside the parallel loops */
+static bool isImageStack(const cv::Mat& images)
+{
+    return images.dims == 3 && images.depth() == CV_8U && (images.channels() == 3 || images.channels() == 4);
+}
+
+cv::Mat FlyCounter::countBatch(const cv::Mat& images, int vialSize)
+{
+    if (!isImageStack(images))
+    {
+        throw std::invalid_argument("countBatch expects a stack of 8 bit RGB images");
+    }
+
+    const int n = images.size[0];
+    std::vector<std::vector<int>> counts(n);
+
+    // exceptions cannot leave the parallel region, the first one is rethrown after it
+    std::exception_ptr error;
+    #pragma omp parallel for schedule(dynamic)
+    for (int i = 0; i < n; ++i)
+    {
+        try
+        {
+            const cv::Mat image(images.size[1], images.size[2], images.type(), (void*)images.ptr(i), images.step[1]);
+            Vials vials = findVials(image, vialSize);
+            this->count(image, vials);
+
+            for (const Vial& vial : vials)
+            {
+                counts[i].push_back(vial.flyCount);
+            }
+        }
+        catch (...)
+        {
+            #pragma omp critical
+            if (!error) error = std::current_exception();
+        }
+    }
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+
+    size_t columns = 0;
+    for (const std::vector<int>& count : counts)
+    {
+        columns = std::max(columns, count.size());
+    }
+    cv::Mat results(n, (int)columns, CV_32SC1, cv::Scalar(-1));
+    for (int i = 0; i < n; ++i)
+    {
+        std::copy(counts[i].begin(), counts[i].end(), results.ptr<int>(i));
+    }
+    return results;
+}
+
+cv::Mat FlyCounter::countCrops(const cv::Mat& crops, int vialSize)
+{
+    if (!isImageStack(crops))
+    {
+        throw std::invalid_argument("countCrops expects a stack of 8 bit RGB images");
+    }
+
+    const int  n    = crops.size[0];
+    const Vial vial = circularVial(cv::Size(crops.size[2], crops.size[1]), vialSize);
+    cv::Mat results(n, 1, CV_32SC1, cv::Scalar(0));
+
+    // exceptions cannot leave the parallel region, the first one is rethrown after it
+    std::exception_ptr error;
+    #pragma omp parallel
+    {
+        // the vial buffers are reused by all crops of a thread
+        Vials vials(1, vial);
+
+        #pragma omp for schedule(dynamic)
+        for (int i = 0; i < n; ++i)
+        {
+            try
+            {
+                const cv::Mat crop(crops.size[1], crops.size[2], crops.type(), (void*)crops.ptr(i), crops.step[1]);
+                results.at<int>(i) = this->count(crop, vials);
+            }
+            catch (...)
+            {
+                #pragma omp critical
+                if (!error) error = std::current_exception();
+            }
+        }
+    }
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+    return results;
+}
+
 cv::Mat FlyCounter::generateThresholdImage(const cv::Mat &img)
 {
     cv::Mat ret;
@@ -82,69 +194,359 @@ cv::Mat FlyCounter::generateThresholdImage(const cv::Mat &img)
     return ret;
 }
 
-cv::Mat FlyCounter::generateClusterImage(const cv::Mat &img, Vials &vials)
+/* adaptive variant - the global threshold is replaced within each vial by one derived from the vial's own statistics */
+cv::Mat FlyCounter::generateThresholdImage(const cv::Mat &img, const Vials& vials)
 {
-    std::map<int, int> colorMap;
-    cv::Mat clusterImg = cv::Mat(img.size(), img.type(), cv::Scalar(0));
-    int colorIndex = 0;
+    if (this->thresholdMode == GLOBAL)
+    {
+        return this->generateThresholdImage(img);
+    }
 
-    /* draw colored flies on the image */
+    /* one gray conversion serves the global threshold and the vial statistics */
+    cv::Mat gray, ret;
+    cv::cvtColor(img, gray, CV_RGB2GRAY);
+    cv::threshold(gray, ret, this->threshold, 255, CV_THRESH_BINARY_INV);
+    for (const Vial& vial : vials)
+    {
+        int value = this->vialThreshold(gray, vial);
+        this->thresholdVial(gray, vial, value, ret);
+    }
+    return ret;
+}
+
+/* thresholds the vial interiors straight into runs, no full-frame binary image is created */
+void FlyCounter::thresholdVials(const cv::Mat& img, Vials& vials)
+{
+    cv::Mat gray;
+    cv::cvtColor(img, gray, CV_RGB2GRAY);
     for (Vial& vial : vials)
     {
-        for (auto size : vial.clusterSizes)
+        int value = this->thresholdMode == GLOBAL ? this->threshold : this->vialThreshold(gray, vial);
+        const uchar level = (uchar)std::min(std::max(value, 0), 255);
+
+        vial.runs.clear();
+        cv::Rect roi = vial.bounds & cv::Rect(0, 0, gray.cols, gray.rows);
+        for (int y = roi.y; y < roi.y + roi.height; ++y)
         {
-            if (size.first == 0) continue;
-            if (colorMap.find(size.first) == colorMap.end())
+            const Span& span = vial.spans[y - vial.bounds.y];
+            const uchar* row = gray.ptr<uchar>(y);
+            int end = std::min(span[1], roi.x + roi.width);
+            for (int x = std::max(span[0], roi.x); x < end; ++x)
             {
-                colorMap[size.first] = colorIndex;
-                ++colorIndex;
+                if (row[x] > level) continue;
+
+                int begin = x;
+                while (x < end && row[x] <= level) ++x;
+                vial.runs.push_back(Run(y, begin, x));
             }
         }
+    }
+}
+
+/* computes the threshold of a single vial from the gray values inside of it */
+int FlyCounter::vialThreshold(const cv::Mat& gray, const Vial& vial)
+{
+    cv::Rect roi = vial.bounds & cv::Rect(0, 0, gray.cols, gray.rows);
+    if (roi.area() == 0) return this->threshold;
+
+    if (this->thresholdMode == MEAN_STDDEV)
+    {
+        /* mean and variance of the vial interior from the integral images, one lookup per row span */
+        cv::Mat sum, sqsum;
+        cv::integral(gray(roi), sum, sqsum, CV_32S);
+
+        double total = 0.0, squares = 0.0, count = 0.0;
+        for (int y = roi.y; y < roi.y + roi.height; ++y)
+        {
+            const Span& span = vial.spans[y - vial.bounds.y];
+            int begin = std::max(span[0], roi.x) - roi.x;
+            int end   = std::min(span[1], roi.x + roi.width) - roi.x;
+            if (begin >= end) continue;
+
+            int row = y - roi.y;
+            total   += sum.at<int>(row + 1, end) - sum.at<int>(row + 1, begin) - sum.at<int>(row, end) + sum.at<int>(row, begin);
+            squares += sqsum.at<double>(row + 1, end) - sqsum.at<double>(row + 1, begin) - sqsum.at<double>(row, end) + sqsum.at<double>(row, begin);
+            count   += end - begin;
+        }
+        if (count == 0.0) return this->threshold;
 
-        for (unsigned int i = 0; i < vial.labels.size(); ++i)
+        double mean   = total / count;
+        double stddev = std::sqrt(std::max(squares / count - mean * mean, 0.0));
+        return (int)(mean - this->thresholdK * stddev);
+    }
+
+    /* Otsu's method on the histogram of the vial interior */
+    int histogram[256] = {0};
+    int count = 0;
+    for (int y = roi.y; y < roi.y + roi.height; ++y)
+    {
+        const Span& span = vial.spans[y - vial.bounds.y];
+        const uchar* row = gray.ptr<uchar>(y);
+        for (int x = std::max(span[0], roi.x), end = std::min(span[1], roi.x + roi.width); x < end; ++x)
         {
+            ++histogram[row[x]];
+        }
+        count += std::max(std::min(span[1], roi.x + roi.width) - std::max(span[0], roi.x), 0);
+    }
+    if (count == 0) return this->threshold;
+
+    double total = 0.0;
+    for (int i = 0; i < 256; ++i) total += i * histogram[i];
 
-            if (std::abs(vial.labels[i]) == 0) continue;
-            Color color = COLORS[colorMap[std::abs(vial.labels[i])] % COLORS.size()];
-            cv::Vec2f coord = vial.flyPixels.at<cv::Vec2f>(0, i);
-            clusterImg.at<cv::Vec3b>(coord[1],coord[0]) = color;
+    double background = 0.0, best = 0.0;
+    int    weight = 0, value = this->threshold;
+    for (int i = 0; i < 256; ++i)
+    {
+        weight += histogram[i];
+        if (weight == 0) continue;
+        if (weight == count) break;
+
+        background += i * histogram[i];
+        double meanBackground = background / weight;
+        double meanForeground = (total - background) / (count - weight);
+        double variance       = (double)weight * (count - weight) * std::pow(meanBackground - meanForeground, 2);
+        if (variance > best)
+        {
+            best  = variance;
+            value = i;
         }
     }
-    return clusterImg;
+    return value;
+}
+
+/* thresholds of all vials for the current mode, computed once per burst */
+std::vector<int> FlyCounter::vialThresholds(const cv::Mat& img, const Vials& vials)
+{
+    std::vector<int> thresholds(vials.size(), this->threshold);
+    if (this->thresholdMode == GLOBAL || vials.empty())
+    {
+        return thresholds;
+    }
+
+    cv::Mat gray;
+    cv::cvtColor(img, gray, CV_RGB2GRAY);
+    for (size_t i = 0; i < vials.size(); ++i)
+    {
+        thresholds[i] = this->vialThreshold(gray, vials[i]);
+    }
+    return thresholds;
+}
+
+/* estimates the number of flies above the relative height line of each vial directly from a raw (BGR) camera frame */
+/* only the vial rows above the line are touched, gray conversion and thresholding happen in a single pass */
+/* pixels set in the optional background mask (static foreground of the round images) are skipped like in the rounds */
+void FlyCounter::countAboveLine(const cv::Mat& bgr, const Vials& vials, const std::vector<int>& thresholds, const cv::Mat& background, float line, std::vector<int>& counts)
+{
+    const bool masked = !background.empty() && background.size() == bgr.size();
+    counts.assign(vials.size(), 0);
+    for (size_t i = 0; i < vials.size(); ++i)
+    {
+        const Vial& vial = vials[i];
+        cv::Rect roi = vial.bounds & cv::Rect(0, 0, bgr.cols, bgr.rows);
+        int lineRow  = vial.bounds.y + (int)(vial.bounds.height * (1.0f - line));
+        int level    = thresholds[i];
+        int pixels   = 0;
+
+        for (int y = roi.y; y < std::min(lineRow, roi.y + roi.height); ++y)
+        {
+            const Span& span = vial.spans[y - vial.bounds.y];
+            const uchar* row    = bgr.ptr<uchar>(y);
+            const uchar* skip   = masked ? background.ptr<uchar>(y) : nullptr;
+            for (int x = std::max(span[0], roi.x), end = std::min(span[1], roi.x + roi.width); x < end; ++x)
+            {
+                if (skip && skip[x]) continue;
+
+                // same fixed point weights as cvtColor
+                const uchar* pixel = row + 3 * x;
+                int gray = (pixel[0] * 1868 + pixel[1] * 9617 + pixel[2] * 4899 + (1 << 13)) >> 14;
+                pixels  += gray <= level;
+            }
+        }
+        counts[i] = (int)std::lround((float)pixels / (float)this->pixelsPerFly);
+    }
+}
+
+/* binarizes the vial interior with the passed threshold, the inner loop is branch-free so that it vectorizes */
+void FlyCounter::thresholdVial(const cv::Mat& gray, const Vial& vial, int value, cv::Mat& thresh)
+{
+    cv::Rect roi = vial.bounds & cv::Rect(0, 0, gray.cols, gray.rows);
+    const uchar level = (uchar)std::min(std::max(value, 0), 255);
+
+    for (int y = roi.y; y < roi.y + roi.height; ++y)
+    {
+        const Span& span = vial.spans[y - vial.bounds.y];
+        const uchar* src = gray.ptr<uchar>(y);
+        uchar*       dst = thresh.ptr<uchar>(y);
+        for (int x = std::max(span[0], roi.x), end = std::min(span[1], roi.x + roi.width); x < end; ++x)
+        {
+            dst[x] = src[x] > level ? 0 : 255;
+        }
+    }
+}
+
+cv::Mat FlyCounter::generateClusterImage(const cv::Mat &img, Vials &vials)
+{
+    ClusterRenderer renderer;
+    return renderer.render(vials, img.size());
+}
+
+const cv::Mat& ClusterRenderer::render(const Vials& vials, const cv::Size& size)
+{
+    const Color BLACK(0, 0, 0);
+
+    if (this->image.size() != size || this->image.type() != CV_8UC3)
+    {
+        this->image.create(size, CV_8UC3);
+        this->image.setTo(cv::Scalar(0));
+        this->drawn.clear();
+    }
+    for (const cv::Rect& bounds : this->drawn)
+    {
+        this->image(bounds).setTo(cv::Scalar(0));
+    }
+    this->drawn.clear();
+
+    /* draw colored flies on the image */
+    size_t colorIndex = 0;
+    for (const Vial& vial : vials)
+    {
+        /* the labels are in the order of the run pixels */
+        if (vial.labels.empty() || vial.labels.size() != (size_t)countPixels(vial.runs)) continue;
+
+        /* cluster ids are at most the number of pixels, so a dense table replaces the label lookup */
+        this->lut.assign(vial.labels.size() + 1, BLACK);
+        for (const auto& clusterSize : vial.clusterSizes)
+        {
+            if (clusterSize.first <= 0 || (size_t)clusterSize.first >= this->lut.size()) continue;
+            this->lut[clusterSize.first] = FlyCounter::COLORS[colorIndex++ % FlyCounter::COLORS.size()];
+        }
+
+        const cv::Rect bounds = cv::Rect(vial.bounds) & cv::Rect(cv::Point(0, 0), size);
+        this->drawn.push_back(bounds);
+
+        const Cluster* label = vial.labels.data();
+        for (const Run& run : vial.runs)
+        {
+            cv::Vec3b* row = this->image.ptr<cv::Vec3b>(run.row);
+            for (int x = run.begin; x < run.end; ++x, ++label)
+            {
+                const size_t cluster = (size_t)std::abs(*label);
+                if (cluster == 0 || cluster >= this->lut.size()) continue;
+                row[x] = this->lut[cluster];
+            }
+        }
+    }
+    return this->image;
 }
 
 int FlyCounter::countFlies(const cv::Mat& threshImg, Vials& vials)
 {
-    int flies_total = 0;
-    cv::Mat flies;
-    for (Vial& vial : vials)
+    return this->countFlies(threshImg, vials, nullptr);
+}
+
+/* how far a re-detected vial may move between rounds and still count as the same vial */
+static const int REUSE_TOLERANCE = 3;
+
+/* finds the previous round's vial at the same rack position, by index if no layout was fitted */
+static const Vial* previousVial(const Vial& vial, const Vials& previous, size_t index)
+{
+    const Vial* last = nullptr;
+    if (vial.row >= 0 && vial.column >= 0)
+    {
+        for (const Vial& candidate : previous)
+        {
+            if (candidate.row == vial.row && candidate.column == vial.column) last = &candidate;
+        }
+    }
+    else if (index < previous.size())
     {
-        /* mask the vails */
-        cv::Mat mask =  cv::Mat(threshImg.size(), threshImg.type(), cv::Scalar(0));
-        cv::drawContours(mask, std::vector<std::vector<cv::Point>>(1,vial.pts), 0, cv::Scalar(255, 255, 255), -1);
-        cv::bitwise_and(mask, threshImg, flies);
+        last = &previous[index];
+    }
+    if (last == nullptr) return nullptr;
 
-        /* get their pixel coordinates in an array */
-        cv::findNonZero(flies, vial.flyPixels);
-        vial.flyPixels.convertTo(vial.flyPixels, CV_32FC2);
+    cv::Point drift = vial.center - last->center;
+    if (std::abs(drift.x) > REUSE_TOLERANCE || std::abs(drift.y) > REUSE_TOLERANCE) return nullptr;
+    return last;
+}
 
-        /* cluster the white pixels using DBSCAN */
-        int numberOfPixels = vial.flyPixels.size().height;
-        Cluster labels[numberOfPixels];
+/* a vial whose fly pixels are identical to the one of the previous round, relative to its bounds, re-uses its clustering instead of running DBSCAN again */
+static bool reuseClusters(Vial& vial, const Vials* previous, size_t index)
+{
+    if (previous == nullptr) return false;
 
+    const Vial* last = previousVial(vial, *previous, index);
+    if (last == nullptr || last->runs.size() != vial.runs.size() || last->labels.size() != (size_t)vial.flyPixels.rows) return false;
 
-        HPDBSCAN dbscan((float*) vial.flyPixels.data, numberOfPixels, 2 /* dimensions */);
-        dbscan.scan(this->epsilon, this->minPoints, labels);
+    const cv::Point shift = vial.bounds.tl() - last->bounds.tl();
+    for (size_t i = 0; i < vial.runs.size(); ++i)
+    {
+        const Run& run  = vial.runs[i];
+        const Run& prev = last->runs[i];
+        if (run.row != prev.row + shift.y || run.begin != prev.begin + shift.x || run.end != prev.end + shift.x) return false;
+    }
+
+    vial.labels       = last->labels;
+    vial.clusterSizes = last->clusterSizes;
+    vial.clusterCenters.clear();
+    for (const auto& center : last->clusterCenters)
+    {
+        vial.clusterCenters[center.first] = center.second + cv::Point2f((float)shift.x, (float)shift.y);
+    }
+    return true;
+}
 
-        vial.labels = std::vector<Cluster>(labels, labels + numberOfPixels);
+int FlyCounter::countFlies(const cv::Mat& threshImg, Vials& vials, const Vials* previous)
+{
+    /* the vial spans mask the threshold image */
+    for (Vial& vial : vials)
+    {
+        vial.runs.clear();
+        extractRuns(threshImg, vial, vial.runs);
+    }
+    return this->countFlies(vials, previous);
+}
 
-        /* accumulate the number of pixels belonging to one cluster */
+int FlyCounter::countFlies(Vials& vials, const Vials* previous, ScanStats* stats)
+{
+    for (size_t index = 0; index < vials.size(); ++index)
+    {
+        Vial& vial = vials[index];
+
+        /* get the fly pixel coordinates in an array */
+        runsToPoints(vial.runs, vial.flyPixels);
+        if (reuseClusters(vial, previous, index)) continue;
+
+        /* cluster the white pixels using DBSCAN on their runs */
+        int numberOfPixels = vial.flyPixels.size().height;
+        vial.labels.resize(numberOfPixels);
+
+        RunDBSCAN dbscan(vial.runs.data(), vial.runs.size());
+        dbscan.scan(this->epsilon, this->minPoints, vial.labels.data(), stats);
+
+        /* accumulate the number of pixels and the centroid of each cluster */
         vial.clusterSizes.clear();
+        vial.clusterCenters.clear();
         for (int i = 0; i < numberOfPixels; ++i)
         {
-            ++vial.clusterSizes[std::abs(labels[i])];
+            int cluster = std::abs(vial.labels[i]);
+            ++vial.clusterSizes[cluster];
+            vial.clusterCenters[cluster] += vial.flyPixels.at<cv::Point2f>(i);
+        }
+        for (auto& center : vial.clusterCenters)
+        {
+            float size = (float)vial.clusterSizes[center.first];
+            center.second = cv::Point2f(center.second.x / size, center.second.y / size);
         }
-        /* count the flies based on the clusters and color them in the cluster image */
+    }
+    return this->countFromClusters(vials);
+}
+
+/* (re-)count the flies based on the already computed cluster sizes, e.g. after pixelsPerFly changed */
+int FlyCounter::countFromClusters(Vials& vials)
+{
+    int flies_total = 0;
+    for (Vial& vial : vials)
+    {
         vial.flyCount = 0;
         for (auto size : vial.clusterSizes)
         {
@@ -176,3 +578,13 @@ void FlyCounter::setThreshold(int value)
 {
     this->threshold = value;
 }
+
+void FlyCounter::setThresholdMode(int value)
+{
+    this->thresholdMode = value;
+}
+
+void FlyCounter::setThresholdK(float value)
+{
+    this->thresholdK = value;
+}
@@ -6,6 +6,14 @@
 
 typedef std::vector<Color> Colors;
 
+/* threshold modes - one global value or adaptive per vial */
+enum ThresholdMode
+{
+    GLOBAL      = 0,
+    OTSU        = 1,
+    MEAN_STDDEV = 2
+};
+
 class FlyCounter
 {
 protected:
@@ -14,30 +22,66 @@ protected:
     int   numberOfFlies;
     int   pixelsPerFly;
     int   threshold;
+    int   thresholdMode;
+    float thresholdK;
+
+    int  vialThreshold(const cv::Mat& gray, const Vial& vial);
+    void thresholdVial(const cv::Mat& gray, const Vial& vial, int value, cv::Mat& thresh);
 
 public:
     FlyCounter();
 
     /* External API */
     int count(const cv::Mat& img, Vials& vials);
+    /* counts a stack of N RGB images (an N x H x W x 3 uint8 array) in parallel, returns the flies of each vial as N x vials int matrix, -1 for absent vials */
+    cv::Mat countBatch(const cv::Mat& images, int vialSize);
+    /* like countBatch for single-vial crops, all crops share one circular vial template instead of detecting their vial, returns N x 1 */
+    cv::Mat countCrops(const cv::Mat& crops, int vialSize);
     cv::Mat generateThresholdImage(const cv::Mat& img);
+    cv::Mat generateThresholdImage(const cv::Mat& img, const Vials& vials);
     cv::Mat generateClusterImage(const cv::Mat& thresh, Vials &vials);
     int countFlies(const cv::Mat & threshImg, Vials &vials);
+    int countFlies(const cv::Mat & threshImg, Vials &vials, const Vials* previous);
+
+    /* Sparse pipeline - the threshold stage stores the foreground runs in the vials, clustering consumes them without a dense mask */
+    void thresholdVials(const cv::Mat& img, Vials& vials);
+    int countFlies(Vials& vials, const Vials* previous=nullptr, ScanStats* stats=nullptr);
+    int countFromClusters(Vials& vials);
+
+    /* Streamlined high frame rate path - no clustering, fly pixels above the height line per vial */
+    std::vector<int> vialThresholds(const cv::Mat& img, const Vials& vials);
+    void countAboveLine(const cv::Mat& bgr, const Vials& vials, const std::vector<int>& thresholds, const cv::Mat& background, float line, std::vector<int>& counts);
 
     /* Getters */
     int getEpsilon();
     int getMinPoints();
     int getPixelsPerFly();
     int getThreshold();
+    int getThresholdMode();
+    float getThresholdK();
 
     /* Setters */
     void setEpsilon(int value);
     void setMinPoints(int value);
     void setPixelsPerFly(int value);
     void setThreshold(int value);
+    void setThresholdMode(int value);
+    void setThresholdK(float value);
 
     /* Color Map */
     static Colors COLORS;
 };
 
+/* Draws the clusters of the vials in distinct colors, the image is re-used across frames and only written inside the vial bounds */
+class ClusterRenderer
+{
+protected:
+    cv::Mat               image;
+    std::vector<cv::Rect> drawn; // vial bounds of the last render, cleared before the next one
+    Colors                lut;   // absolute label -> color of the vial being drawn
+
+public:
+    const cv::Mat& render(const Vials& vials, const cv::Size& size);
+};
+
 #endif // FLYCOUNTER_H
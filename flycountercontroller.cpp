@@ -4,8 +4,10 @@
 #include <QStandardPaths>
 #include <QTemporaryFile>
 
+#include <algorithm>
 #include <chrono>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
 #include <map>
 
@@ -13,6 +15,9 @@
 #include "logger.h"
 #include "reflexcam.h"
 #include "noshaker.h"
+#include "profiler.h"
+#include "tracer.h"
+#include "sparsemask.h"
 #include "usbshaker.h"
 #include "webcamera.h"
 
@@ -23,29 +28,47 @@ FlyCounterController::FlyCounterController(QObject* parent)
     leadTime(Seconds(0)),
     roundTime(Seconds(0)),
     shakeTime(Seconds(0)),
+    burstFrames(0),
+    burstRate(20),
+    heightLine(0.5f),
 
     // analysis parameters
     vialSize(0),
+    vialDetection(GREEN_SCREEN),
+    vialDetector(createVialDetector(GREEN_SCREEN)),
     fliesTotal(0),
+    trackFlies(false),
+    autoCalibrate(false),
 
     // results
     output(QTemporaryFile().fileName().toStdString()),
     saveImages(false),
+    syncInterval(1),
+    binaryLog(false),
+    archiveMode(FULL_IMAGES),
+    trace(false),
     // devices
     camera(nullptr),
     shaker(nullptr),
 
     // threaded execution
-    running(false)
+    running(false),
+
+    // multi-rack operation
+    rack(-1),
+    startOffset(Seconds(0)),
+    analysis(nullptr)
 
 {}
 
 /* image analysis mainloop */
 void FlyCounterController::process()
 {
-    this->experimentStart = Clock::now();
-    Timepoint measure     = this->experimentStart + this->roundTime;
+    Timepoint measure     = this->experimentStart + this->startOffset + this->roundTime;
     Timepoint shake       = measure - this->leadTime;
+    Timepoint burst       = shake;
+    bool      bursting    = false;
+    Tracer::setThreadName("controller");
 
     while (this->running)
     {
@@ -56,30 +79,180 @@ void FlyCounterController::process()
         if (current > shake)
         {
             shake += this->roundTime;
+            ScopedTimer timer("shake");
             this->shaker->shakeFor(this->shakeTime);
+            // the short-lived shaker threads are not traced, the shaking period is recorded here instead
+            if (Tracer::isEnabled()) Tracer::complete("shaking", current, current + this->shakeTime);
+            burst    = current + this->shakeTime;
+            bursting = this->burstFrames > 0;
+        }
+
+        // Shaking is over, capture the climbing flies?
+        if (bursting && current > burst)
+        {
+            bursting = false;
+            ScopedTimer timer("burst");
+            this->captureBurst();
         }
 
         // Time to take a picture?
         if (current > measure)
         {
             measure += this->roundTime;
-            this->updateImages();
-            this->writeResults(elapsed);
-            if (this->saveImages)
             {
-                this->writeImage(elapsed);
+                ScopedTimer timer("round");
+                // rounds without a new image write nothing, the last results would only be repeated
+                if (this->updateImages())
+                {
+                    if (this->autoCalibrate)
+                    {
+                        ScopedTimer timer("calibration");
+                        this->calibrate();
+                    }
+                    {
+                        ScopedTimer timer("results");
+                        this->writeResults();
+                        if (this->trackFlies)
+                        {
+                            this->writeTracks();
+                        }
+                    }
+                    if (this->saveImages)
+                    {
+                        ScopedTimer timer("image queue");
+                        this->writeImage(elapsed);
+                    }
+                }
             }
+            this->writeTiming();
         }
 
         emit timeUpdate(QString::number(elapsed) + "s");
     }
 }
 
+/* feeds the cluster sizes of the current round into the calibrator and re-counts with the updated pixels per fly estimate */
+void FlyCounterController::calibrate()
+{
+    this->imageLock.lock();
+    this->calibrator.add(this->vials);
+    int estimate = this->calibrator.estimate();
+    bool changed = estimate > 0 && estimate != this->flycounter.getPixelsPerFly();
+    if (changed)
+    {
+        this->flycounter.setPixelsPerFly(estimate);
+        this->fliesTotal = this->flycounter.countFromClusters(this->vials);
+    }
+    this->imageLock.unlock();
+
+    if (changed)
+    {
+        Logger::info(QString("Calibrated pixels per fly to %1").arg(estimate));
+        emit pixelsPerFlyUpdate(estimate);
+        emit countUpdate(QString::number(this->fliesTotal));
+    }
+}
+
+/* captures a short high frame rate sequence right after shaking and counts the flies above the height line per vial and frame */
+void FlyCounterController::captureBurst()
+{
+    const std::chrono::microseconds period(1000000 / std::max(this->burstRate, 1));
+
+    cv::Mat frame;
+    if (!this->camera->getImage(frame))
+    {
+        Logger::error("Could not obtain burst image");
+        return;
+    }
+    Timepoint start = Clock::now();
+
+    // vial geometry, thresholds and the learned background are fixed for the whole burst
+    this->imageLock.lock();
+    Vials vials = this->vials;
+    cv::Mat background = this->background.isTrained() ? this->background.getMask() : cv::Mat();
+    this->imageLock.unlock();
+
+    // only the vials of the burst frames are corrected, the whole frame only if they are not known yet
+    cv::Mat corrected;
+    if (this->lensCorrection.isEnabled())
+    {
+        if (vials.empty())
+        {
+            this->lensCorrection.correct(frame, corrected);
+        }
+        else
+        {
+            corrected.create(frame.size(), frame.type());
+            this->lensCorrection.correctVials(frame, vials, corrected);
+        }
+    }
+    const cv::Mat& image = corrected.empty() ? frame : corrected;
+
+    cv::Mat rgb;
+    cv::cvtColor(image, rgb, CV_BGR2RGB);
+    if (vials.empty())
+    {
+        vials = this->vialDetector->detect(rgb, this->vialSize);
+    }
+    std::vector<int> thresholds = this->flycounter.vialThresholds(rgb, vials);
+
+    std::vector<std::pair<double, std::vector<int>>> counts;
+    counts.reserve(this->burstFrames);
+    int late = 0;
+    for (int i = 0; i < this->burstFrames && this->running; ++i)
+    {
+        if (i > 0 && !this->camera->getImage(frame))
+        {
+            Logger::error("Could not obtain burst image");
+            break;
+        }
+        if (i > 0 && !corrected.empty())
+        {
+            this->lensCorrection.correctVials(frame, vials, corrected);
+        }
+        counts.push_back(std::make_pair(convertToSeconds(Clock::now() - this->experimentStart), std::vector<int>()));
+        this->flycounter.countAboveLine(image, vials, thresholds, background, this->heightLine, counts.back().second);
+
+        Timepoint next = start + period * (i + 1);
+        if (Clock::now() > next)
+        {
+            ++late;
+        }
+        else
+        {
+            std::this_thread::sleep_until(next);
+        }
+    }
+    if (late > 0)
+    {
+        Logger::warn(QString("Burst fell behind %1 fps in %2 of %3 frames").arg(this->burstRate).arg(late).arg(counts.size()));
+    }
+
+    // one line per frame: seconds since experiment start, frame number, flies above the line per vial
+    // the counts are estimated from the pixels without clustering, so no minimum cluster size filters noise
+    std::stringstream lines;
+    lines << std::fixed << std::setprecision(3);
+    for (size_t i = 0; i < counts.size(); ++i)
+    {
+        lines << counts[i].first << "\t" << i;
+        for (int count : counts[i].second)
+        {
+            lines << "\t" << count;
+        }
+        lines << "\n";
+    }
+    this->burstResults.write(lines.str());
+    this->burstResults.endRound();
+}
+
 /* detect the built-in cameras; priorities: reflex, webcam, file */
 void FlyCounterController::detectCamera()
 {
+    // each rack uses the camera with its index
+    const int device = std::max(this->rack, 0);
+
     // prefer reflex camera
-    this->camera = new ReflexCam();
+    this->camera = new ReflexCam(device);
     if (this->camera->isAccessable())
     {
         Logger::info("Detected reflex camera");
@@ -90,7 +263,7 @@ void FlyCounterController::detectCamera()
     delete this->camera;
     Logger::warn("Could not find reflex camera");
 
-    this->camera = new WebCamera();
+    this->camera = new WebCamera(device);
     if (this->camera->isAccessable())
     {
         Logger::info("Detected web camera");
@@ -107,7 +280,7 @@ void FlyCounterController::detectCamera()
 
 void FlyCounterController::detectShaker()
 {
-    this->shaker = new USBShaker();
+    this->shaker = new USBShaker(std::max(this->rack, 0));
     if (this->shaker->isAccessable())
     {
         Logger::info("Detected USB shaker");
@@ -120,11 +293,16 @@ void FlyCounterController::detectShaker()
     Logger::info("Unable to shake");
 }
 
-/* create the directory for all the output data - always called before write */
+/* create the directory for all the output data - called once per experiment */
 std::string FlyCounterController::makeExperimentDirectory()
 {
     std::stringstream pathSS;
-    pathSS << this->output << "/" << timeToString(this->experimentStart);
+    pathSS << this->output;
+    if (this->rack >= 0)
+    {
+        pathSS << "/rack" << this->rack + 1;
+    }
+    pathSS << "/" << timeToString(this->experimentStart);
 
     std::string path = pathSS.str();
     QDir().mkpath(QString::fromStdString(path));
@@ -132,38 +310,161 @@ std::string FlyCounterController::makeExperimentDirectory()
     return path;
 }
 
-/* stores the fly image */
+/* opens the result files of the experiment, they stay open until the experiment is stopped */
+void FlyCounterController::openResults()
+{
+    this->experimentPath = this->makeExperimentDirectory();
+
+    this->results.setSyncInterval(this->syncInterval);
+    if (!this->results.open(this->experimentPath + "/results.csv"))
+    {
+        Logger::error("Could not write results.csv file");
+    }
+
+    this->trackResults.setSyncInterval(this->syncInterval);
+    if (this->trackFlies && !this->trackResults.open(this->experimentPath + "/tracks.csv"))
+    {
+        Logger::error("Could not write tracks.csv file");
+    }
+
+    this->burstResults.setSyncInterval(this->syncInterval);
+    if (this->burstFrames > 0 && !this->burstResults.open(this->experimentPath + "/burst.csv"))
+    {
+        Logger::error("Could not write burst.csv file");
+    }
+
+    // the profiler is shared by all racks, only the first one writes and resets it
+    this->timingResults.setSyncInterval(this->syncInterval);
+    if (this->rack <= 0 && !this->timingResults.open(this->experimentPath + "/timing.csv"))
+    {
+        Logger::error("Could not write timing.csv file");
+    }
+
+    this->experimentLog.setSyncInterval(this->syncInterval);
+    if (this->binaryLog && !this->experimentLog.open(this->experimentPath))
+    {
+        Logger::error("Could not write binary experiment log");
+    }
+}
+
+/* flushes the pending rounds to disk and closes the result files */
+void FlyCounterController::closeResults()
+{
+    this->timingResults.close();
+    this->results.close();
+    this->trackResults.close();
+    this->burstResults.close();
+    this->experimentLog.close();
+}
+
+/* hands the images of the round to the archiver, the encoding and writing happens on its thread */
 void FlyCounterController::writeImage(int elapsed)
 {
-    std::stringstream path;
-    path << this->makeExperimentDirectory() << "/" << elapsed << ".jpg";
+    std::stringstream prefix;
+    prefix << this->experimentPath << "/" << elapsed;
 
     this->imageLock.lock();
-    if (!cv::imwrite(path.str(), this->cameraImage))
+    if (this->cameraImage.empty())
+    {
+        this->imageLock.unlock();
+        return;
+    }
+
+    switch (this->archiveMode)
     {
-        Logger::error("Could not save image");
+        case VIAL_CROPS:
+            for (size_t i = 0; i < this->vials.size(); ++i)
+            {
+                // vials found in the padded detection image may reach past the frame
+                cv::Rect roi = this->vials[i].bounds & cv::Rect(0, 0, this->cameraImage.cols, this->cameraImage.rows);
+                if (roi.area() == 0) continue;
+
+                std::stringstream path;
+                path << prefix.str() << "_" << i << ".png";
+                this->archiver.archive(path.str(), this->cameraImage(roi).clone(), true);
+            }
+            break;
+        case MASKS:
+        {
+            std::vector<uchar> encoded = encodeMask(this->vials, this->cameraImage.size());
+            this->archiver.archive(prefix.str() + ".rle", encoded);
+            break;
+        }
+        default:
+        {
+            std::vector<uchar> encoded;
+            if (this->camera->getEncoded(encoded))
+            {
+                this->archiver.archive(prefix.str() + ".jpg", encoded);
+            }
+            else
+            {
+                this->archiver.archive(prefix.str() + ".jpg", this->cameraImage.clone(), true);
+            }
+        }
     }
     this->imageLock.unlock();
 }
 
-/* output the fly counts in a tab-separated list into a file, leading value is the collection timestamp */
-void FlyCounterController::writeResults(int elapsed)
+/* stage durations of the round in ms, one line per stage: seconds, stage, calls, total, p50, p95 and max of the recent rounds */
+void FlyCounterController::writeTiming()
 {
-    std::string path = this->makeExperimentDirectory();
-    std::ofstream file(path + "/results.csv", std::ios::app);
-    if (!file.good())
+    if (this->rack > 0) return;
+
+    std::stringstream lines;
+    double elapsed = convertToSeconds(this->imageTime - this->experimentStart);
+    for (const StageTiming& timing : Profiler::summary(true))
     {
-        Logger::error("Could not write results.csv file");
-        return;
+        if (timing.calls == 0) continue;
+        lines << std::fixed << std::setprecision(3) << elapsed << "\t" << timing.stage << "\t" << timing.calls << "\t" << timing.total << "\t" << timing.p50 << "\t" << timing.p95 << "\t" << timing.max << "\n";
     }
 
-    file << elapsed;
-    for (Vial vial : this->vials)
+    this->timingResults.write(lines.str());
+    this->timingResults.endRound();
+}
+
+/* output the fly counts in a tab-separated list into a file, leading value is the collection timestamp in seconds */
+void FlyCounterController::writeResults()
+{
+    std::stringstream line;
+    line << std::fixed << std::setprecision(3) << convertToSeconds(this->imageTime - this->experimentStart);
+    for (const Vial& vial : this->vials)
     {
-        file << "\t" << vial.flyCount;
+        line << "\t" << vial.flyCount;
+    }
+    line << "\n";
+
+    this->results.write(line.str());
+    this->results.endRound();
+
+    // per cluster detail, allows to re-derive the counts for another pixels per fly
+    if (this->experimentLog.isOpen())
+    {
+        this->experimentLog.write(convertToSeconds(this->imageTime - this->experimentStart), this->vials, this->flycounter.getPixelsPerFly());
     }
-    file << std::endl;
-    file.close();
+}
+
+/* match the clusters to the ones of the previous rounds and output the positions of the tracked flies, one fly per line */
+void FlyCounterController::writeTracks()
+{
+    this->imageLock.lock();
+    this->tracker.update(this->vials);
+    const std::vector<Tracks> tracks = this->tracker.getTracks();
+    this->imageLock.unlock();
+
+    std::stringstream lines;
+    double elapsed = convertToSeconds(this->imageTime - this->experimentStart);
+    for (size_t vial = 0; vial < tracks.size(); ++vial)
+    {
+        for (const Track& track : tracks[vial])
+        {
+            if (track.missed > 0) continue;
+            lines << std::fixed << std::setprecision(3) << elapsed << "\t" << vial << "\t" << track.id << "\t" << track.position.x << "\t" << track.position.y << "\t" << track.height << "\t" << track.size << "\n";
+        }
+    }
+
+    this->trackResults.write(lines.str());
+    this->trackResults.endRound();
 }
 
 /** public **/
@@ -174,13 +475,24 @@ const cv::Mat& FlyCounterController::getCameraImage()
     return this->cameraImage;
 }
 
+/* the counting works on the vial runs, the dense threshold image is only rendered when it is displayed */
 const cv::Mat& FlyCounterController::getThresholdImage()
 {
+    if (this->thresholdImage.empty() && !this->cameraImage.empty())
+    {
+        this->thresholdImage = renderMask(this->vials, this->cameraImage.size());
+    }
     return this->thresholdImage;
 }
 
+/* like the threshold image the cluster image is only rendered when it is displayed, into the same buffer every time */
 const cv::Mat& FlyCounterController::getClusterImage()
 {
+    if (this->clusterImage.empty() && !this->cameraImage.empty())
+    {
+        ScopedTimer timer("cluster image");
+        this->clusterImage = this->clusterRenderer.render(this->vials, this->cameraImage.size());
+    }
     return this->clusterImage;
 }
 
@@ -200,6 +512,21 @@ const Duration& FlyCounterController::getShakeTime()
     return this->shakeTime;
 }
 
+int FlyCounterController::getBurstFrames()
+{
+    return this->burstFrames;
+}
+
+int FlyCounterController::getBurstRate()
+{
+    return this->burstRate;
+}
+
+float FlyCounterController::getHeightLine()
+{
+    return this->heightLine;
+}
+
 /* analysis parameter getters */
 int FlyCounterController::getEpsilon()
 {
@@ -221,11 +548,46 @@ int FlyCounterController::getThreshold()
     return this->flycounter.getThreshold();
 }
 
+int FlyCounterController::getThresholdMode()
+{
+    return this->flycounter.getThresholdMode();
+}
+
+float FlyCounterController::getThresholdK()
+{
+    return this->flycounter.getThresholdK();
+}
+
+int FlyCounterController::getBackgroundFrames()
+{
+    return this->background.getTrainingFrames();
+}
+
 int FlyCounterController::getVialSize()
 {
     return this->vialSize;
 }
 
+int FlyCounterController::getVialDetection()
+{
+    return this->vialDetection;
+}
+
+const std::string& FlyCounterController::getLensCalibration()
+{
+    return this->lensCalibration;
+}
+
+bool FlyCounterController::isTracking()
+{
+    return this->trackFlies;
+}
+
+bool FlyCounterController::isAutoCalibrating()
+{
+    return this->autoCalibrate;
+}
+
 bool FlyCounterController::isRunning()
 {
     return this->running;
@@ -242,59 +604,200 @@ const std::string& FlyCounterController::getOutput()
     return this->output;
 }
 
+int FlyCounterController::getSyncInterval()
+{
+    return this->syncInterval;
+}
+
+int FlyCounterController::getArchiveMode()
+{
+    return this->archiveMode;
+}
+
+bool FlyCounterController::isTracing()
+{
+    return this->trace;
+}
+
+bool FlyCounterController::isLoggingBinary()
+{
+    return this->binaryLog;
+}
 
-void FlyCounterController::updateImages()
+/* multi-rack operation */
+int FlyCounterController::getRack()
+{
+    return this->rack;
+}
+
+void FlyCounterController::setRack(int index)
+{
+    this->rack = index;
+}
+
+void FlyCounterController::setStartOffset(const Clock::duration& offset)
+{
+    this->startOffset = offset;
+}
+
+void FlyCounterController::setAnalysisPool(AnalysisPool* pool)
+{
+    this->analysis = pool;
+}
+
+void FlyCounterController::copySettings(const FlyCounterController& other)
+{
+    this->leadTime      = other.leadTime;
+    this->roundTime     = other.roundTime;
+    this->shakeTime     = other.shakeTime;
+    this->burstFrames   = other.burstFrames;
+    this->burstRate     = other.burstRate;
+    this->heightLine    = other.heightLine;
+
+    this->vialSize      = other.vialSize;
+    this->setVialDetection(other.vialDetection);
+    this->flycounter    = other.flycounter;
+    this->background.setTrainingFrames(other.background.getTrainingFrames());
+    this->trackFlies    = other.trackFlies;
+    this->autoCalibrate = other.autoCalibrate;
+
+    this->output        = other.output;
+    this->saveImages    = other.saveImages;
+    this->syncInterval  = other.syncInterval;
+    this->binaryLog     = other.binaryLog;
+    this->archiveMode   = other.archiveMode;
+}
+
+
+bool FlyCounterController::updateImages()
 {
     this->imageLock.lock();
-    this->updateCameraImage();
-    this->updateThresholdImage();
-    this->updateClusterImage();
+    const bool captured = this->captureImage();
+
+    // the camera is waited for on the own thread, the analysis may run on the workers shared by all racks
+    auto analyze = [this, captured]()
+    {
+        if (captured)
+        {
+            this->prepareImage();
+        }
+        this->updateThresholdImage();
+        this->updateClusterImage();
+    };
+    if (this->analysis != nullptr)
+    {
+        this->analysis->run(analyze);
+    }
+    else
+    {
+        analyze();
+    }
     this->imageLock.unlock();
 
     emit countUpdate(QString::number(this->fliesTotal));
     emit imageUpdate();
+    return captured;
 }
 
 /* fetches new image from the camera */
 void FlyCounterController::updateCameraImage()
 {
-    if (!this->camera->getImage(this->cameraImage))
+    if (this->captureImage())
+    {
+        this->prepareImage();
+    }
+}
+
+bool FlyCounterController::captureImage()
+{
+    bool captured;
+    {
+        ScopedTimer timer("capture");
+        captured = this->camera->getImage(this->cameraImage);
+    }
+    if (!captured)
     {
         this->cameraImage = cv::Mat(); // create an empty matrix
         Logger::error("Could not obtain camera image");
-        return;
+        return false;
+    }
+    this->imageTime = Clock::now();
+    return true;
+}
+
+/* converts a freshly captured image and detects the vials in it */
+void FlyCounterController::prepareImage()
+{
+    {
+        ScopedTimer timer("color conversion");
+        cv::cvtColor(this->cameraImage, this->cameraImage, CV_BGR2RGB);
     }
-    cv::cvtColor(this->cameraImage, this->cameraImage, CV_BGR2RGB);
+    if (this->lensCorrection.isEnabled())
+    {
+        // the vials of the last round tell where the correction is needed, the remaining pixels are only shown
+        ScopedTimer timer("lens correction");
+        if (this->vials.empty())
+        {
+            this->lensCorrection.correct(this->cameraImage, this->correctedImage);
+        }
+        else
+        {
+            this->cameraImage.copyTo(this->correctedImage);
+            this->lensCorrection.correctVials(this->cameraImage, this->vials, this->correctedImage);
+        }
+        cv::swap(this->cameraImage, this->correctedImage);
+    }
+    ScopedTimer timer("vial detection");
     this->updateVials();
 }
 
 void FlyCounterController::updateClusterImage()
 {
+    this->clusterImage = cv::Mat();
     if (this->cameraImage.empty())
     {
-        this->clusterImage = cv::Mat();
         return;
     }
 
-    this->flycounter.countFlies(this->thresholdImage, this->vials);
-
-    clusterImage = this->flycounter.generateClusterImage(this->cameraImage, this->vials);
+    // during an experiment vials whose fly pixels did not change re-use the clusters of the previous round
+    ScopedTimer timer("clustering");
+    const Vials* previous = this->running && this->trackFlies ? &this->previousVials : nullptr;
+    ScanStats   phases;
+    this->fliesTotal = this->flycounter.countFlies(this->vials, previous, &phases);
+    this->previousVials = this->vials;
+
+    // the DBSCAN phases summed over all vials, one sample per round like the other stages
+    Profiler::record("dbscan cores", phases.local);
+    Profiler::record("dbscan segments", phases.index);
+    Profiler::record("dbscan union", phases.merge);
+    Profiler::record("dbscan labels", phases.label);
 }
 
-/* update the threshold image from the currently set camera image */
+/* update the vial runs from the currently set camera image, the threshold image is rendered on demand */
 void FlyCounterController::updateThresholdImage()
 {
+    this->thresholdImage = cv::Mat();
     if (this->cameraImage.empty())
     {
-        this->thresholdImage = cv::Mat();
         return;
     }
-    this->thresholdImage = this->flycounter.generateThresholdImage(this->cameraImage);
+    {
+        ScopedTimer timer("threshold");
+        this->flycounter.thresholdVials(this->cameraImage, this->vials);
+    }
+
+    // learn the static pixels from the first rounds of an experiment, afterwards suppress them
+    ScopedTimer timer("background");
+    if (this->running)
+    {
+        this->background.add(this->vials, this->cameraImage.size());
+    }
+    this->background.apply(this->vials);
 }
 
 void FlyCounterController::updateVials()
 {
-    this->vials = findVials(this->cameraImage, this->vialSize);
+    this->vials = this->vialDetector->detect(this->cameraImage, this->vialSize);
 }
 
 /* validated time setters - adjust the respective two other timers according to the passed individual timer */
@@ -345,6 +848,22 @@ void FlyCounterController::validatedSetShakeTime(const Duration& time)
     }
 }
 
+/* burst settings - zero frames disables the burst */
+void FlyCounterController::setBurstFrames(int value)
+{
+    this->burstFrames = value;
+}
+
+void FlyCounterController::setBurstRate(int value)
+{
+    this->burstRate = value;
+}
+
+void FlyCounterController::setHeightLine(float value)
+{
+    this->heightLine = value;
+}
+
 /* detects the external devices - camera and shaker */
 void FlyCounterController::detectDevices()
 {
@@ -360,6 +879,24 @@ void FlyCounterController::start()
 {
     if (!this->running)
     {
+        this->calibrator.reset();
+        this->background.reset();
+        this->tracker.reset();
+        this->previousVials.clear();
+        this->vialDetector->reset(); // the rack may have been moved between experiments
+        this->experimentStart = Clock::now();
+        this->openResults();
+        // the profiler, log file and trace are process wide, the first rack owns them
+        if (this->rack <= 0)
+        {
+            Profiler::clear();
+            Logger::setFile(this->experimentPath + "/log.txt");
+        }
+        if (this->trace && this->rack <= 0)
+        {
+            Tracer::start();
+        }
+        this->archiver.start();
         this->running = true;
         this->thread  = std::thread(&FlyCounterController::process, this);
     }
@@ -373,6 +910,17 @@ void FlyCounterController::stop()
     {
         this->thread.join();
     }
+    this->closeResults();
+    this->archiver.stop();
+    if (this->rack > 0)
+    {
+        return;
+    }
+    if (Tracer::isEnabled() && !Tracer::stop(this->experimentPath + "/trace.json"))
+    {
+        Logger::error("Could not write trace.json file");
+    }
+    Logger::setFile("");
 }
 
 /* execution */
@@ -391,6 +939,7 @@ FlyCounterController::~FlyCounterController()
 {
     delete this->camera;
     delete this->shaker;
+    delete this->vialDetector;
 }
 
 /** public slots **/
@@ -411,16 +960,63 @@ void FlyCounterController::setPixelsPerFly(int value)
     this->flycounter.setPixelsPerFly(value);
 }
 
+void FlyCounterController::setAutoCalibrate(bool value)
+{
+    this->autoCalibrate = value;
+}
+
 void FlyCounterController::setThreshold(int value)
 {
     this->flycounter.setThreshold(value);
 }
 
+void FlyCounterController::setThresholdMode(int value)
+{
+    this->flycounter.setThresholdMode(value);
+}
+
+void FlyCounterController::setThresholdK(float value)
+{
+    this->flycounter.setThresholdK(value);
+}
+
+void FlyCounterController::setBackgroundFrames(int value)
+{
+    this->background.setTrainingFrames(value);
+}
+
 void FlyCounterController::setVialSize(int value)
 {
     this->vialSize = value;
 }
 
+void FlyCounterController::setVialDetection(int value)
+{
+    if (value == this->vialDetection) return;
+
+    delete this->vialDetector;
+    this->vialDetection = value;
+    this->vialDetector  = createVialDetector(value);
+}
+
+/* calibration file of tools/calibrate.py, an empty path disables the correction */
+void FlyCounterController::setLensCalibration(const std::string& path)
+{
+    if (path == this->lensCalibration) return;
+
+    this->lensCalibration = path;
+    this->vials.clear(); // the vial positions were found in the other geometry
+    if (path.empty())
+    {
+        this->lensCorrection.clear();
+        return;
+    }
+    if (!this->lensCorrection.load(path))
+    {
+        Logger::error(QString("Could not read the lens calibration %1").arg(QString::fromStdString(path)));
+    }
+}
+
 /* result setters */
 void FlyCounterController::setOutput(const std::string& out)
 {
@@ -431,3 +1027,30 @@ void FlyCounterController::storeImages(bool value)
 {
     this->saveImages = value;
 }
+
+/* number of rounds after which the result files are synced to disk, a crash loses at most this many rounds */
+void FlyCounterController::setSyncInterval(int value)
+{
+    this->syncInterval = value;
+}
+
+void FlyCounterController::setBinaryLog(bool value)
+{
+    this->binaryLog = value;
+}
+
+void FlyCounterController::setArchiveMode(int value)
+{
+    this->archiveMode = value;
+}
+
+/* record a Chrome trace of all threads, written to trace.json in the experiment directory when stopped */
+void FlyCounterController::setTrace(bool value)
+{
+    this->trace = value;
+}
+
+void FlyCounterController::setTracking(bool value)
+{
+    this->trackFlies = value;
+}
@@ -10,10 +10,19 @@
 
 #include <opencv2/opencv.hpp>
 
+#include "analysispool.h"
+#include "backgroundmodel.h"
 #include "cam.h"
+#include "experimentlog.h"
+#include "flycalibrator.h"
 #include "flycounter.h"
+#include "flytracker.h"
+#include "imagearchiver.h"
+#include "lenscorrection.h"
+#include "resultwriter.h"
 #include "shaker.h"
 #include "timer.h"
+#include "vialdetector.h"
 #include "vials.h"
 
 class FlyCounterController : public QObject
@@ -26,6 +35,11 @@ private:
     Duration roundTime;
     Duration shakeTime;
 
+    /* high frame rate burst after each shake */
+    int   burstFrames;
+    int   burstRate;
+    float heightLine;
+
     /* images */
     cv::Mat cameraImage;
     cv::Mat clusterImage;
@@ -33,14 +47,44 @@ private:
 
     /* analysis parameters */
     int   vialSize;
+    int   vialDetection;
+    VialDetector* vialDetector;
+    std::string    lensCalibration;
+    LensCorrection lensCorrection;
+    cv::Mat        correctedImage;
     FlyCounter flycounter;
+    ClusterRenderer clusterRenderer;
     Vials vials;
     int fliesTotal;
 
+    /* static background suppression */
+    BackgroundModel background;
+
+    /* tracking of the flies across rounds */
+    FlyTracker tracker;
+    Vials      previousVials;
+    bool       trackFlies;
+
+    /* pixels per fly calibration */
+    FlyCalibrator calibrator;
+    bool          autoCalibrate;
+
     /* results */
-    Timepoint   experimentStart;
-    std::string output;
-    bool        saveImages;
+    Timepoint    experimentStart;
+    Timepoint    imageTime;
+    std::string  experimentPath;
+    std::string  output;
+    bool         saveImages;
+    int          syncInterval;
+    ResultWriter results;
+    ResultWriter trackResults;
+    ResultWriter burstResults;
+    ResultWriter timingResults;
+    ExperimentLog experimentLog;
+    bool          binaryLog;
+    int           archiveMode;
+    ImageArchiver archiver;
+    bool          trace;
 
     /* devices */
     Cam*    camera;
@@ -51,19 +95,33 @@ private:
     bool        running;
     std::thread thread;
 
+    /* multi-rack operation */
+    int             rack;        // index of the rack, -1 if it is the only one
+    Clock::duration startOffset; // staggers the rounds of the racks, finer than the whole seconds of the round time
+    AnalysisPool*   analysis;    // shared analysis workers, the controller thread analyzes itself if not set
+
     /* internal implementation meat */
     void detectCamera();
     void detectShaker();
+    bool captureImage();
+    void prepareImage();
     void process();
+    void calibrate();
+    void captureBurst();
 
     std::string makeExperimentDirectory();
+    void openResults();
+    void closeResults();
     void writeImage(int elapsed);
-    void writeResults(int elapsed);
+    void writeResults();
+    void writeTracks();
+    void writeTiming();
 
 signals:
     /* GUI signals */
     void countUpdate(QString flies);
     void imageUpdate();
+    void pixelsPerFlyUpdate(int pixelsPerFly);
     void timeUpdate(QString time);
 public:
     explicit FlyCounterController(QObject* parent=nullptr);
@@ -77,21 +135,43 @@ public:
     const Duration& getLeadTime();
     const Duration& getRoundTime();
     const Duration& getShakeTime();
+    int getBurstFrames();
+    int getBurstRate();
+    float getHeightLine();
 
     /* analysis parameter getters */
     int getEpsilon();
     int getMinPoints();
     int getPixelsPerFly();
     int getThreshold();
+    int getThresholdMode();
+    float getThresholdK();
+    int getBackgroundFrames();
     int getVialSize();
+    int getVialDetection();
+    const std::string& getLensCalibration();
+    bool isAutoCalibrating();
+    bool isTracking();
     bool isRunning();
     const Vials& getVials();
 
     /* results */
     const std::string& getOutput();
+    int getSyncInterval();
+    int getArchiveMode();
+    bool isTracing();
+    bool isLoggingBinary();
+
+    /* multi-rack operation */
+    int getRack();
+    void setRack(int index);
+    void setStartOffset(const Clock::duration& offset);
+    void setAnalysisPool(AnalysisPool* pool);
+    /* takes over the schedule, analysis and result settings of another rack, the lens calibration belongs to the own camera */
+    void copySettings(const FlyCounterController& other);
 
     /* image updates */
-    void updateImages();
+    bool updateImages(); // false if no new camera image was captured
     void updateCameraImage();
     void updateThresholdImage();
     void updateClusterImage();
@@ -101,6 +181,9 @@ public:
     void validatedSetLeadTime(const Duration& time);
     void validatedSetRoundTime(const Duration& time);
     void validatedSetShakeTime(const Duration& time);
+    void setBurstFrames(int value);
+    void setBurstRate(int value);
+    void setHeightLine(float value);
 
     /* execution */
     void lock();
@@ -116,10 +199,21 @@ public slots:
     void setEpsilon(int value);
     void setMinPoints(int value);
     void setPixelsPerFly(int value);
+    void setAutoCalibrate(bool value);
     void setThreshold(int value);
+    void setThresholdMode(int value);
+    void setThresholdK(float value);
+    void setBackgroundFrames(int value);
     void setVialSize(int value);
+    void setVialDetection(int value);
+    void setLensCalibration(const std::string& path);
     void setOutput(const std::string& out);
     void storeImages(bool value);
+    void setTracking(bool value);
+    void setSyncInterval(int value);
+    void setBinaryLog(bool value);
+    void setArchiveMode(int value);
+    void setTrace(bool value);
 };
 
 #endif // FLYCOUNTER_H
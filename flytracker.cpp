@@ -0,0 +1,125 @@
+#include "flytracker.h"
+
+#include <algorithm>
+#include <tuple>
+
+const float FlyTracker::SIZE_RATIO = 2.0f;
+
+FlyTracker::FlyTracker()
+:
+nextId(0),
+maxDistance(50.0f)
+{
+
+}
+
+void FlyTracker::update(const Vials& vials)
+{
+    // the vial set changed, e.g. the rack was moved - start over
+    if (this->tracks.size() != vials.size())
+    {
+        this->tracks.assign(vials.size(), Tracks());
+    }
+
+    for (size_t i = 0; i < vials.size(); ++i)
+    {
+        this->updateVial(this->tracks[i], vials[i]);
+    }
+}
+
+void FlyTracker::updateVial(Tracks& vialTracks, const Vial& vial)
+{
+    // collect the clusters of this round
+    std::vector<std::pair<cv::Point2f, int>> clusters;
+    for (const auto& center : vial.clusterCenters)
+    {
+        if (center.first == 0) continue; // noise
+        clusters.push_back(std::make_pair(center.second, vial.clusterSizes.at(center.first)));
+    }
+
+    // all plausible track/cluster pairs, cheapest first
+    const float maxDistance2 = this->maxDistance * this->maxDistance;
+    std::vector<std::tuple<float, size_t, size_t>> candidates;
+    for (size_t t = 0; t < vialTracks.size(); ++t)
+    {
+        for (size_t c = 0; c < clusters.size(); ++c)
+        {
+            cv::Point2f offset = clusters[c].first - vialTracks[t].position;
+            float distance2    = offset.dot(offset);
+            float ratio        = (float)std::max(clusters[c].second, vialTracks[t].size) / (float)std::max(std::min(clusters[c].second, vialTracks[t].size), 1);
+            if (distance2 <= maxDistance2 && ratio <= SIZE_RATIO)
+            {
+                candidates.push_back(std::make_tuple(distance2, t, c));
+            }
+        }
+    }
+    std::sort(candidates.begin(), candidates.end());
+
+    // greedy assignment
+    std::vector<bool> trackMatched(vialTracks.size(), false);
+    std::vector<bool> clusterMatched(clusters.size(), false);
+    for (const auto& candidate : candidates)
+    {
+        size_t t = std::get<1>(candidate);
+        size_t c = std::get<2>(candidate);
+        if (trackMatched[t] || clusterMatched[c]) continue;
+
+        trackMatched[t]   = true;
+        clusterMatched[c] = true;
+
+        Track& track   = vialTracks[t];
+        track.position = clusters[c].first;
+        track.height   = vial.height(track.position);
+        track.size     = clusters[c].second;
+        track.missed   = 0;
+        ++track.age;
+    }
+
+    // age out lost tracks
+    for (size_t t = 0; t < vialTracks.size(); ++t)
+    {
+        if (!trackMatched[t]) ++vialTracks[t].missed;
+    }
+    vialTracks.erase(std::remove_if(vialTracks.begin(), vialTracks.end(), [](const Track& track)
+    {
+        return track.missed > MAX_MISSED;
+    }), vialTracks.end());
+
+    // new flies
+    for (size_t c = 0; c < clusters.size(); ++c)
+    {
+        if (clusterMatched[c]) continue;
+
+        Track track;
+        track.id       = this->nextId++;
+        track.position = clusters[c].first;
+        track.height   = vial.height(track.position);
+        track.size     = clusters[c].second;
+        track.age      = 0;
+        track.missed   = 0;
+        vialTracks.push_back(track);
+    }
+}
+
+void FlyTracker::reset()
+{
+    this->tracks.clear();
+    this->nextId = 0;
+}
+
+/* getters */
+const std::vector<Tracks>& FlyTracker::getTracks() const
+{
+    return this->tracks;
+}
+
+float FlyTracker::getMaxDistance() const
+{
+    return this->maxDistance;
+}
+
+/* setters */
+void FlyTracker::setMaxDistance(float value)
+{
+    this->maxDistance = value;
+}
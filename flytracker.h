@@ -0,0 +1,51 @@
+#ifndef FLYTRACKER_H
+#define FLYTRACKER_H
+
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "vials.h"
+
+/* A fly cluster followed across rounds */
+struct Track
+{
+    int         id;
+    cv::Point2f position;
+    float       height;
+    int         size;
+    int         age;    // rounds since the track was created
+    int         missed; // consecutive rounds without a match
+};
+
+typedef std::vector<Track> Tracks;
+
+/* Matches the clusters of consecutive rounds per vial by centroid distance and size (greedy, best match first) */
+class FlyTracker
+{
+protected:
+    std::vector<Tracks> tracks; // per vial
+    int   nextId;
+    float maxDistance;
+
+    void updateVial(Tracks& vialTracks, const Vial& vial);
+
+public:
+    static const int   MAX_MISSED = 2;    // rounds until a lost track is dropped
+    static const float SIZE_RATIO;        // maximum size change of a matched cluster
+
+    FlyTracker();
+
+    /* Updates the tracks with the (already counted) vials of the current round */
+    void update(const Vials& vials);
+    void reset();
+
+    /* Getters */
+    const std::vector<Tracks>& getTracks() const;
+    float getMaxDistance() const;
+
+    /* Setters */
+    void setMaxDistance(float value);
+};
+
+#endif // FLYTRACKER_H
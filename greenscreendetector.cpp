@@ -0,0 +1,12 @@
+#include "greenscreendetector.h"
+
+GreenScreenDetector::GreenScreenDetector()
+{}
+
+Vials GreenScreenDetector::detect(const cv::Mat& image, int vialSize)
+{
+    return findVials(image, vialSize, &this->layout);
+}
+
+GreenScreenDetector::~GreenScreenDetector()
+{}
@@ -0,0 +1,17 @@
+#ifndef GREENSCREENDETECTOR_H
+#define GREENSCREENDETECTOR_H
+
+#include "vialdetector.h"
+
+/* Vial contours cut out of a green backdrop, see findVials */
+class GreenScreenDetector : public VialDetector
+{
+public:
+    GreenScreenDetector();
+
+    virtual Vials detect(const cv::Mat& image, int vialSize);
+
+    virtual ~GreenScreenDetector();
+};
+
+#endif // GREENSCREENDETECTOR_H
@@ -0,0 +1,95 @@
+#include "houghdetector.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "racklayout.h"
+
+static const double RADIUS_TOLERANCE = 0.1; // relative, about the +-20% area window of the green screen contours
+static const double MIN_DISTANCE     = 1.8; // radii between the centers of neighbouring vials
+static const double SMOOTHING        = 1.5; // px, gaussian sigma against the edges of the flies and the rack
+
+void HoughDetector::findCircles(const cv::Mat& image, double scale, double radius, double distance, int votes, std::vector<cv::Vec3f>& circles)
+{
+    // scale before the color conversion, the full resolution image is only touched by the area interpolation
+    if (scale < 1.0)
+    {
+        cv::resize(image, this->scaled, cv::Size(), scale, scale, CV_INTER_AREA);
+    }
+    else
+    {
+        this->scaled = image;
+    }
+
+    if (this->scaled.channels() > 1)
+    {
+        cv::cvtColor(this->scaled, this->gray, this->scaled.channels() == 4 ? CV_RGBA2GRAY : CV_RGB2GRAY);
+    }
+    else
+    {
+        this->scaled.copyTo(this->gray);
+    }
+    cv::GaussianBlur(this->gray, this->gray, cv::Size(0, 0), SMOOTHING);
+
+    radius *= scale;
+    cv::HoughCircles(this->gray, circles, CV_HOUGH_GRADIENT, 1, distance * scale, EDGE_THRESHOLD, votes,
+                     (int)std::floor(radius * (1.0 - RADIUS_TOLERANCE)), (int)std::ceil(radius * (1.0 + RADIUS_TOLERANCE)));
+}
+
+HoughDetector::HoughDetector()
+{}
+
+Vials HoughDetector::detect(const cv::Mat& image, int vialSize)
+{
+    Vials vials;
+    if (image.empty() || vialSize <= 0) return vials;
+
+    const cv::Rect frame(0, 0, image.cols, image.rows);
+    const double   coarse = std::min(1.0, COARSE_RADIUS / (double)vialSize);
+    const double   fine   = std::min(1.0, FINE_RADIUS   / (double)vialSize);
+
+    std::vector<cv::Vec3f> candidates;
+    this->findCircles(image, coarse, vialSize, MIN_DISTANCE * vialSize, COARSE_VOTES, candidates);
+
+    // a coarse pixel is this many full resolution ones, the refinement window covers that uncertainty
+    const int margin = (int)std::ceil(2.0 / coarse);
+    const int extent = (int)std::ceil(vialSize * (1.0 + RADIUS_TOLERANCE)) + margin;
+
+    std::vector<cv::Vec3f> refined;
+    for (const cv::Vec3f& candidate : candidates)
+    {
+        cv::Point2f center(candidate[0] / coarse, candidate[1] / coarse);
+        float       radius = candidate[2] / coarse;
+
+        cv::Rect window = cv::Rect((int)center.x - extent, (int)center.y - extent, 2 * extent + 1, 2 * extent + 1) & frame;
+        if (window.area() > 0)
+        {
+            this->findCircles(image(window), fine, vialSize, 2 * extent, FINE_VOTES, refined);
+            for (const cv::Vec3f& circle : refined)
+            {
+                cv::Point2f position(window.x + circle[0] / fine, window.y + circle[1] / fine);
+                cv::Point2f offset = position - center;
+                if (offset.dot(offset) <= (float)margin * margin)
+                {
+                    center = position;
+                    radius = circle[2] / fine;
+                    break;
+                }
+            }
+        }
+
+        // vials cut by the image border cannot be counted completely
+        const int r = (int)std::lround(radius);
+        const cv::Rect bounds((int)std::lround(center.x) - r, (int)std::lround(center.y) - r, 2 * r + 1, 2 * r + 1);
+        if ((bounds & frame) == bounds)
+        {
+            vials.push_back(circularVial(cv::Point((int)std::lround(center.x), (int)std::lround(center.y)), r));
+        }
+    }
+
+    this->layout = fitRackLayout(vials, &this->layout);
+    return vials;
+}
+
+HoughDetector::~HoughDetector()
+{}
@@ -0,0 +1,31 @@
+#ifndef HOUGHDETECTOR_H
+#define HOUGHDETECTOR_H
+
+#include "vialdetector.h"
+
+/* Circular vial openings found with a coarse-to-fine Hough transform, needs no backdrop.
+   The whole frame is only searched downscaled, the circles are refined on small full resolution windows. */
+class HoughDetector : public VialDetector
+{
+protected:
+    cv::Mat scaled; // reused between the calls, detection runs on one thread
+    cv::Mat gray;
+
+    /* circles of about the radius in px of the image in the image scaled by the factor, strongest first, in scaled coordinates */
+    void findCircles(const cv::Mat& image, double scale, double radius, double distance, int votes, std::vector<cv::Vec3f>& circles);
+
+public:
+    static const int COARSE_RADIUS  = 16; // px, vial radius in the downscaled frame
+    static const int FINE_RADIUS    = 64; // px, vial radius during the refinement
+    static const int EDGE_THRESHOLD = 80; // upper Canny threshold of the circle edges
+    static const int COARSE_VOTES   = 18; // accumulator votes of a circle in the coarse search
+    static const int FINE_VOTES     = 40; // accumulator votes of a refined circle
+
+    HoughDetector();
+
+    virtual Vials detect(const cv::Mat& image, int vialSize);
+
+    virtual ~HoughDetector();
+};
+
+#endif // HOUGHDETECTOR_H
@@ -0,0 +1,124 @@
+#include "imagearchiver.h"
+
+#include <fstream>
+
+#include "logger.h"
+#include "profiler.h"
+#include "tracer.h"
+
+ImageArchiver::ImageArchiver()
+:
+running(false)
+{
+
+}
+
+/* writer thread mainloop */
+void ImageArchiver::work()
+{
+    Tracer::setThreadName("archiver");
+    std::unique_lock<std::mutex> lock(this->mutex);
+    while (this->running || !this->jobs.empty())
+    {
+        if (this->jobs.empty())
+        {
+            this->condition.wait(lock);
+            continue;
+        }
+
+        Job job = std::move(this->jobs.front());
+        this->jobs.pop_front();
+
+        lock.unlock();
+        this->write(job);
+        lock.lock();
+    }
+}
+
+void ImageArchiver::write(Job& job)
+{
+    ScopedTimer timer("image write");
+    if (!job.encoded.empty())
+    {
+        std::ofstream file(job.path, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(job.encoded.data()), job.encoded.size());
+        if (!file.good())
+        {
+            Logger::error("Could not save image");
+        }
+        return;
+    }
+
+    if (job.rgb)
+    {
+        cv::cvtColor(job.image, job.image, CV_RGB2BGR);
+    }
+    if (!cv::imwrite(job.path, job.image))
+    {
+        Logger::error("Could not save image");
+    }
+}
+
+void ImageArchiver::enqueue(Job& job)
+{
+    bool dropped = false;
+
+    this->mutex.lock();
+    if (this->jobs.size() >= MAX_PENDING)
+    {
+        this->jobs.pop_front();
+        dropped = true;
+    }
+    this->jobs.push_back(std::move(job));
+    this->mutex.unlock();
+    this->condition.notify_one();
+
+    if (dropped)
+    {
+        Logger::warn("Image archive cannot keep up, dropped an image");
+    }
+}
+
+void ImageArchiver::start()
+{
+    if (this->thread.joinable()) return;
+
+    this->running = true;
+    this->thread  = std::thread(&ImageArchiver::work, this);
+}
+
+void ImageArchiver::stop()
+{
+    this->mutex.lock();
+    this->running = false;
+    this->mutex.unlock();
+    this->condition.notify_one();
+
+    if (this->thread.joinable())
+    {
+        this->thread.join();
+    }
+}
+
+void ImageArchiver::archive(const std::string& path, std::vector<uchar>& encoded)
+{
+    Job job;
+    job.path = path;
+    job.rgb  = false;
+    job.encoded.swap(encoded);
+    this->enqueue(job);
+}
+
+void ImageArchiver::archive(const std::string& path, const cv::Mat& image, bool rgb)
+{
+    Job job;
+    job.path  = path;
+    job.image = image;
+    job.rgb   = rgb;
+    this->enqueue(job);
+}
+
+ImageArchiver::~ImageArchiver()
+{
+    this->stop();
+}
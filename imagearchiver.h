@@ -0,0 +1,59 @@
+#ifndef IMAGEARCHIVER_H
+#define IMAGEARCHIVER_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+/* what to archive per round */
+enum ArchiveMode
+{
+    FULL_IMAGES = 0, // camera image, original JPEG bytes if available
+    VIAL_CROPS  = 1, // lossless PNG crops of the vial bounding boxes
+    MASKS       = 2  // run-length encoded threshold masks of the vials
+};
+
+/* Writes images to disk on a background thread so that neither the GUI nor the next round wait for the encoder */
+class ImageArchiver
+{
+protected:
+    struct Job
+    {
+        std::string        path;
+        std::vector<uchar> encoded; // written as is if not empty
+        cv::Mat            image;   // encoded according to the file extension otherwise
+        bool               rgb;     // image channel order needs to be swapped before encoding
+    };
+
+    std::deque<Job>         jobs;
+    std::mutex              mutex;
+    std::condition_variable condition;
+    std::thread             thread;
+    bool                    running;
+
+    void work();
+    void write(Job& job);
+    void enqueue(Job& job);
+
+public:
+    static const size_t MAX_PENDING = 16; // images, older ones are dropped if the disk cannot keep up
+
+    ImageArchiver();
+
+    void start();
+    /* Stops the writer thread after all pending images are written */
+    void stop();
+
+    /* Queue the passed data, the images must not be modified afterwards */
+    void archive(const std::string& path, std::vector<uchar>& encoded);
+    void archive(const std::string& path, const cv::Mat& image, bool rgb=false);
+
+    ~ImageArchiver();
+};
+
+#endif // IMAGEARCHIVER_H
@@ -0,0 +1,110 @@
+#include "lenscorrection.h"
+
+LensCorrection::LensCorrection()
+{}
+
+void LensCorrection::buildMaps(const cv::Size& imageSize)
+{
+    this->size = imageSize;
+
+    cv::Mat original;
+    this->cameraMatrix.convertTo(original, CV_64F);
+
+    // a calibration of the same sensor at another resolution only scales the focal lengths and the principal point
+    cv::Mat camera = original.clone();
+    if (this->calibrated.width > 0 && this->calibrated.height > 0)
+    {
+        const double sx = imageSize.width  / (double)this->calibrated.width;
+        const double sy = imageSize.height / (double)this->calibrated.height;
+        camera.at<double>(0, 0) *= sx;
+        camera.at<double>(0, 2) *= sx;
+        camera.at<double>(1, 1) *= sy;
+        camera.at<double>(1, 2) *= sy;
+    }
+
+    // the homography works on calibration pixels, in normalized camera coordinates it is independent of the resolution
+    cv::Mat rectification;
+    if (!this->perspective.empty())
+    {
+        cv::Mat homography;
+        this->perspective.convertTo(homography, CV_64F);
+        rectification = original.inv() * homography * original;
+    }
+
+    cv::initUndistortRectifyMap(camera, this->distortion, rectification, camera, imageSize, CV_16SC2, this->map, this->fractions);
+}
+
+bool LensCorrection::load(const std::string& path)
+{
+    this->clear();
+
+    cv::FileStorage storage(path, cv::FileStorage::READ);
+    if (!storage.isOpened()) return false;
+
+    int width  = 0;
+    int height = 0;
+    storage["image_width"]             >> width;
+    storage["image_height"]            >> height;
+    storage["camera_matrix"]           >> this->cameraMatrix;
+    storage["distortion_coefficients"] >> this->distortion;
+    if (!storage["perspective"].empty())
+    {
+        storage["perspective"] >> this->perspective;
+    }
+    storage.release();
+
+    if (this->cameraMatrix.rows != 3 || this->cameraMatrix.cols != 3 ||
+        (!this->perspective.empty() && (this->perspective.rows != 3 || this->perspective.cols != 3)))
+    {
+        this->clear();
+        return false;
+    }
+    this->calibrated = cv::Size(width, height);
+    return true;
+}
+
+void LensCorrection::clear()
+{
+    this->cameraMatrix = cv::Mat();
+    this->distortion   = cv::Mat();
+    this->perspective  = cv::Mat();
+    this->calibrated   = cv::Size();
+    this->size         = cv::Size();
+    this->map          = cv::Mat();
+    this->fractions    = cv::Mat();
+}
+
+bool LensCorrection::isEnabled() const
+{
+    return !this->cameraMatrix.empty();
+}
+
+void LensCorrection::correct(const cv::Mat& image, cv::Mat& corrected)
+{
+    if (image.size() != this->size)
+    {
+        this->buildMaps(image.size());
+    }
+    cv::remap(image, corrected, this->map, this->fractions, CV_INTER_LINEAR);
+}
+
+void LensCorrection::correctVials(const cv::Mat& image, const Vials& vials, cv::Mat& corrected)
+{
+    if (image.size() != this->size)
+    {
+        this->buildMaps(image.size());
+    }
+
+    // the tables hold absolute source positions, so a window of them remaps into the same window of the output
+    const cv::Rect frame(0, 0, image.cols, image.rows);
+    for (const Vial& vial : vials)
+    {
+        const int margin = vial.radius / 4 + MARGIN;
+        const cv::Rect window = cv::Rect(vial.bounds.x - margin, vial.bounds.y - margin,
+                                         vial.bounds.width + 2 * margin, vial.bounds.height + 2 * margin) & frame;
+        if (window.area() == 0) continue;
+
+        cv::Mat target = corrected(window);
+        cv::remap(image, target, this->map(window), this->fractions(window), CV_INTER_LINEAR);
+    }
+}
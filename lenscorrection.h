@@ -0,0 +1,43 @@
+#ifndef LENSCORRECTION_H
+#define LENSCORRECTION_H
+
+#include <string>
+
+#include <opencv2/opencv.hpp>
+
+#include "vials.h"
+
+/* Undistortion of the camera lens and an optional perspective correction of the rack plane.
+   The calibration is written by tools/calibrate.py, the remap tables are computed once per image size
+   in fixed point so that the remap runs on the vectorized integer path of OpenCV. */
+class LensCorrection
+{
+protected:
+    cv::Mat  cameraMatrix;
+    cv::Mat  distortion;
+    cv::Mat  perspective; // 3x3 homography of the undistorted image, none if empty
+    cv::Size calibrated;  // image size of the calibration
+
+    cv::Size size;        // image size of the tables
+    cv::Mat  map;         // CV_16SC2, integer source position per pixel
+    cv::Mat  fractions;   // CV_16UC1, interpolation weights index per pixel
+
+    void buildMaps(const cv::Size& imageSize);
+
+public:
+    static const int MARGIN = 8; // px, corrected around the vial bounds on top of a quarter radius
+
+    LensCorrection();
+
+    /* Reads a calibration, false and disabled if it cannot be read */
+    bool load(const std::string& path);
+    void clear();
+    bool isEnabled() const;
+
+    /* Corrects the whole image, needed to find the vials the first time */
+    void correct(const cv::Mat& image, cv::Mat& corrected);
+    /* Corrects the surroundings of the vials only, corrected has to be allocated at the image size and keeps its other pixels */
+    void correctVials(const cv::Mat& image, const Vials& vials, cv::Mat& corrected);
+};
+
+#endif // LENSCORRECTION_H
@@ -1,27 +1,183 @@
 #include "logger.h"
-#include "timer.h"
 
-QPlainTextEdit* Logger::messages = nullptr;
+/** LogFile **/
+
+LogFile::LogFile() :
+    running(false)
+{}
+
+bool LogFile::open(const std::string& path)
+{
+    this->close();
+    this->file.open(path, std::ios::out | std::ios::app);
+    if (!this->file.is_open()) return false;
+
+    this->running = true;
+    this->thread  = std::thread(&LogFile::work, this);
+    return true;
+}
+
+void LogFile::close()
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->running = false;
+    }
+    this->condition.notify_one();
+    if (this->thread.joinable())
+    {
+        this->thread.join();
+    }
+    if (this->file.is_open())
+    {
+        this->file.close();
+    }
+}
+
+void LogFile::write(const std::string& line)
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        if (!this->running) return;
+        this->lines.push_back(line);
+    }
+    this->condition.notify_one();
+}
+
+void LogFile::work()
+{
+    std::deque<std::string> pending;
+    std::unique_lock<std::mutex> lock(this->mutex);
+
+    while (this->running || !this->lines.empty())
+    {
+        this->condition.wait(lock, [this] { return !this->running || !this->lines.empty(); });
+        pending.swap(this->lines);
+
+        lock.unlock();
+        for (const std::string& line : pending)
+        {
+            this->file << line << '\n';
+        }
+        this->file.flush();
+        pending.clear();
+        lock.lock();
+    }
+}
+
+LogFile::~LogFile()
+{
+    this->close();
+}
+
+/** Logger **/
+
+Logger::Entry       Logger::entries[Logger::CAPACITY];
+std::atomic<size_t> Logger::head(0);
+size_t              Logger::tail = 0;
+std::atomic<size_t> Logger::dropped(0);
+
+QPlainTextEdit*     Logger::messages = nullptr;
+LogFile             Logger::file;
 
 void Logger::setOutput(QPlainTextEdit* out)
 {
     Logger::messages = out;
 }
 
+void Logger::setFile(const std::string& path)
+{
+    // everything logged so far belongs to the previous file
+    Logger::flush();
+    Logger::file.close();
+    if (!path.empty() && !Logger::file.open(path))
+    {
+        Logger::error(QString("Could not open log file %1").arg(QString::fromStdString(path)));
+    }
+}
+
+/* lock-free multi-producer enqueue, only claims a slot and copies the implicitly shared message */
+void Logger::push(Level level, const QString& message)
+{
+    size_t pos = Logger::head.load(std::memory_order_relaxed);
+    Entry* entry;
+
+    for (;;)
+    {
+        entry = &Logger::entries[pos % Logger::CAPACITY];
+        const size_t sequence = entry->sequence.load(std::memory_order_acquire);
+        const size_t writable = pos / Logger::CAPACITY * 2;
+
+        if (sequence == writable)
+        {
+            if (Logger::head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+        }
+        else if (sequence < writable)
+        {
+            // the slot still holds a message of the previous lap, the queue is full
+            Logger::dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        else
+        {
+            pos = Logger::head.load(std::memory_order_relaxed);
+        }
+    }
+
+    entry->level   = level;
+    entry->time    = Clock::now();
+    entry->message = message;
+    entry->sequence.store(pos / Logger::CAPACITY * 2 + 1, std::memory_order_release);
+}
+
+void Logger::flush()
+{
+    static const char* const COLORS[] = {nullptr, "orange", "red"};
+    static const char* const NAMES[]  = {"INFO", "WARN", "ERROR"};
+
+    for (;;)
+    {
+        Entry&       entry    = Logger::entries[Logger::tail % Logger::CAPACITY];
+        const size_t readable = Logger::tail / Logger::CAPACITY * 2 + 1;
+        if (entry.sequence.load(std::memory_order_acquire) != readable) break;
+
+        const Level   level   = entry.level;
+        const QString time    = QString::fromStdString(timeToString(entry.time));
+        const QString message = entry.message;
+        entry.message = QString();
+        entry.sequence.store(readable + 1, std::memory_order_release);
+        ++Logger::tail;
+
+        if (Logger::messages != nullptr)
+        {
+            QString html = QString("<font style=\"font-style:italic\">[%1]</font> %2").arg(time, message);
+            if (COLORS[level] != nullptr)
+            {
+                html = QString("<font style=\"color:%1;\">%2</font>").arg(COLORS[level], html);
+            }
+            Logger::messages->appendHtml(html);
+        }
+        Logger::file.write(QString("[%1] %2 %3").arg(time, NAMES[level], message).toStdString());
+    }
+
+    const size_t lost = Logger::dropped.exchange(0, std::memory_order_relaxed);
+    if (lost > 0)
+    {
+        Logger::warn(QString("%1 log messages were dropped").arg(lost));
+    }
+}
+
 void Logger::info(const QString& message)
 {
-    if (Logger::messages == nullptr) return;
-    Logger::messages->appendHtml(QString("<font style=\"font-style:italic\">[%1]</font> %2").arg(QString::fromStdString(timeToString(Clock::now())), message));
+    Logger::push(Logger::INFO, message);
 }
 
 void Logger::warn(const QString &message)
 {
-    if (Logger::messages == nullptr) return;
-    Logger::messages->appendHtml(QString("<font style=\"color:orange;\"><font style=\"font-style:italic\">[%1]</font> %2</font>").arg(QString::fromStdString(timeToString(Clock::now())), message));
+    Logger::push(Logger::WARN, message);
 }
 
 void Logger::error(const QString& message)
 {
-    if (Logger::messages == nullptr) return;
-    Logger::messages->appendHtml(QString("<font style=\"color:red;\"><font style=\"font-style:italic\">[%1]</font> %2</font>").arg(QString::fromStdString(timeToString(Clock::now())), message));
+    Logger::push(Logger::ERROR, message);
 }
@@ -1,18 +1,83 @@
 #ifndef LOGGER_H
 #define LOGGER_H
 
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
 #include <string>
+#include <thread>
 
 #include <QPlainTextEdit>
 #include <QString>
 
+#include "timer.h"
+
+/* Appends log lines to a text file on a background thread */
+class LogFile
+{
+protected:
+    std::deque<std::string> lines;
+    std::mutex              mutex;
+    std::condition_variable condition;
+    std::thread             thread;
+    std::ofstream           file;
+    bool                    running;
+
+    void work();
+
+public:
+    LogFile();
+
+    bool open(const std::string& path);
+    /* Stops the writer thread after all pending lines are written */
+    void close();
+    void write(const std::string& line);
+
+    ~LogFile();
+};
+
+/* Thread-safe logging, messages are queued and formatted when the GUI thread flushes them */
 class Logger
 {
 private:
-    static QPlainTextEdit* messages;
+    enum Level
+    {
+        INFO,
+        WARN,
+        ERROR
+    };
+
+    /* the slot is writable in lap n if sequence == 2n and readable if sequence == 2n + 1 */
+    struct Entry
+    {
+        std::atomic<size_t> sequence;
+        Level               level;
+        Timepoint           time;
+        QString             message;
+    };
+
+    static const size_t CAPACITY = 1024; // messages, newer ones are dropped if the GUI cannot keep up
+
+    static Entry               entries[CAPACITY];
+    static std::atomic<size_t> head;
+    static size_t              tail;
+    static std::atomic<size_t> dropped;
+
+    static QPlainTextEdit*     messages;
+    static LogFile             file;
+
+    static void push(Level level, const QString& message);
 
 public:
+    static const int FLUSH_INTERVAL = 100; // ms
+
     static void setOutput(QPlainTextEdit* out);
+    /* Additionally write all messages to the given file, an empty path closes the file */
+    static void setFile(const std::string& path);
+    /* Format and display all queued messages, must be called from the GUI thread */
+    static void flush();
 
     static void info(const QString& message);
     static void warn(const QString& message);
@@ -3,12 +3,14 @@
 #include <QGraphicsPixmapItem>
 #include <QSettings>
 #include <QStandardPaths>
+#include <QTableWidgetItem>
 #include <QTimer>
 
 #include <opencv2/opencv.hpp>
 
 #include "logger.h"
 #include "mainwindow.h"
+#include "profiler.h"
 #include "ui_mainwindow.h"
 #include "vials.h"
 
@@ -21,18 +23,34 @@ const QString MainWindow::DISPLAY_VIALS  = "displayVials";
 const QString MainWindow::LEAD_TIME      = "leadTime";
 const QString MainWindow::ROUND_TIME     = "roundTime";
 const QString MainWindow::SHAKE_TIME     = "shakeTime";
+const QString MainWindow::BURST_FRAMES   = "burstFrames";
+const QString MainWindow::BURST_RATE     = "burstRate";
+const QString MainWindow::RACKS          = "racks";
+const QString MainWindow::HEIGHT_LINE    = "heightLine";
 const QString MainWindow::EPSILON        = "epsilon";
 const QString MainWindow::MIN_POINTS     =  "minPoints";
 const QString MainWindow::PIXELS_PER_FLY = "pixelsPerFly";
+const QString MainWindow::AUTO_CALIBRATE = "autoCalibrate";
 const QString MainWindow::THRESHOLD      = "threshold";
+const QString MainWindow::THRESHOLD_MODE = "thresholdMode";
+const QString MainWindow::THRESHOLD_K    = "thresholdK";
+const QString MainWindow::BACKGROUND_FRAMES = "backgroundFrames";
 const QString MainWindow::VIAL_SIZE      = "vialSize";
+const QString MainWindow::VIAL_DETECTION = "vialDetection";
+const QString MainWindow::LENS_CALIBRATION = "lensCalibration";
 const QString MainWindow::OUTPUT_PATH    = "outputPath";
 const QString MainWindow::SAVE_IMAGES    = "saveImages";
+const QString MainWindow::TRACK_FLIES    = "trackFlies";
+const QString MainWindow::SYNC_INTERVAL  = "syncInterval";
+const QString MainWindow::BINARY_LOG     = "binaryLog";
+const QString MainWindow::ARCHIVE_MODE   = "archiveMode";
+const QString MainWindow::TRACE          = "trace";
 
 MainWindow::MainWindow(QWidget* parent) :
     QMainWindow(parent),
     ui(new Ui::MainWindow),
-    flyCounter(this)
+    flyCounter(this),
+    rackController(&flyCounter)
 {
     this->setupUI();
     Logger::info("Booting...");
@@ -73,6 +91,9 @@ void MainWindow::setupUI()
     this->showMaximized();
 
     Logger::setOutput(this->ui->messages);
+    QTimer* logTimer = new QTimer(this);
+    connect(logTimer, SIGNAL(timeout()), this, SLOT(updateLog()));
+    logTimer->start(Logger::FLUSH_INTERVAL);
 }
 
 /* registers the QT interface signals */
@@ -80,13 +101,20 @@ void MainWindow::setupSignals()
 {
     connect(&this->flyCounter, SIGNAL(countUpdate(QString)), this->ui->flies, SLOT(setText(QString)));
     connect(&this->flyCounter, SIGNAL(imageUpdate()),        this,            SLOT(updateImage()));
+    connect(&this->flyCounter, SIGNAL(pixelsPerFlyUpdate(int)), this,         SLOT(updatePixelsPerFly(int)));
     connect(&this->flyCounter, SIGNAL(timeUpdate(QString)),  this->ui->timer, SLOT(setText(QString)));
     connect(this->ui->messageDock, SIGNAL(visibilityChanged(bool)), this->ui->actionShow_Log, SLOT(setChecked(bool)));
+    connect(this->ui->timingDock,  SIGNAL(visibilityChanged(bool)), this->ui->actionShow_Timing, SLOT(setChecked(bool)));
 }
 
 /* loads initial settings from the default location, if not present creates them first from the value set in the interface */
 void MainWindow::setupSettings()
 {
+    this->rackController.setConfiguration([this](int index, FlyCounterController* rack)
+    {
+        this->configureRack(index, rack);
+    });
+
     QFileInfo fileInfo(DEFAULT_PATH);
     if (fileInfo.exists() && fileInfo.isFile())
     {
@@ -176,18 +204,34 @@ void MainWindow::userInterfaceEnabled(bool enabled)
     this->ui->leadTime->setEnabled(enabled);
     this->ui->roundTime->setEnabled(enabled);
     this->ui->shakeTime->setEnabled(enabled);
+    this->ui->burstFrames->setEnabled(enabled);
+    this->ui->burstRate->setEnabled(enabled);
+    this->ui->racks->setEnabled(enabled);
+    this->ui->heightLine->setEnabled(enabled);
 
     /* analysis */
     this->ui->epsilon->setEnabled(enabled);
     this->ui->minPoints->setEnabled(enabled);
     this->ui->pixelsPerFly->setEnabled(enabled);
+    this->ui->autoCalibrate->setEnabled(enabled);
     this->ui->threshold->setEnabled(enabled);
+    this->ui->thresholdMode->setEnabled(enabled);
+    this->ui->thresholdK->setEnabled(enabled);
+    this->ui->backgroundFrames->setEnabled(enabled);
     this->ui->vialSize->setEnabled(enabled);
+    this->ui->vialDetection->setEnabled(enabled);
+    this->ui->lensCalibration->setEnabled(enabled);
+    this->ui->lensCalibrationBrowser->setEnabled(enabled);
 
     /* results */
     this->ui->outputPath->setEnabled(enabled);
     this->ui->outputPathBrowser->setEnabled(enabled);
     this->ui->saveImages->setEnabled(enabled);
+    this->ui->trackFlies->setEnabled(enabled);
+    this->ui->syncInterval->setEnabled(enabled);
+    this->ui->binaryLog->setEnabled(enabled);
+    this->ui->archiveMode->setEnabled(enabled);
+    this->ui->trace->setEnabled(enabled);
 }
 
 /* settings loading/saving */
@@ -202,20 +246,64 @@ void MainWindow::loadSettings(const QString& path)
     this->on_leadTime_valueChanged(settings.value(MainWindow::LEAD_TIME).toInt());
     this->ui->shakeTime->setValue(settings.value(MainWindow::SHAKE_TIME).toInt());
     this->on_shakeTime_valueChanged(settings.value(MainWindow::SHAKE_TIME).toInt());
+    this->ui->burstFrames->setValue(settings.value(MainWindow::BURST_FRAMES).toInt());
+    this->on_burstFrames_valueChanged(settings.value(MainWindow::BURST_FRAMES).toInt());
+    this->ui->burstRate->setValue(settings.value(MainWindow::BURST_RATE, 20).toInt());
+    this->on_burstRate_valueChanged(settings.value(MainWindow::BURST_RATE, 20).toInt());
+    this->ui->racks->setValue(settings.value(MainWindow::RACKS, 1).toInt());
+    this->on_racks_valueChanged(settings.value(MainWindow::RACKS, 1).toInt());
+    this->ui->heightLine->setValue(settings.value(MainWindow::HEIGHT_LINE, 0.5).toDouble());
+    this->on_heightLine_valueChanged(settings.value(MainWindow::HEIGHT_LINE, 0.5).toDouble());
     this->ui->epsilon->setValue(settings.value(MainWindow::EPSILON).toInt());
     this->on_epsilon_valueChanged(settings.value(MainWindow::EPSILON).toInt());
     this->ui->minPoints->setValue(settings.value(MainWindow::MIN_POINTS).toInt());
     this->on_minPoints_valueChanged(settings.value(MainWindow::MIN_POINTS).toInt());
     this->ui->pixelsPerFly->setValue(settings.value(MainWindow::PIXELS_PER_FLY).toInt());
     this->on_pixelsPerFly_valueChanged(settings.value(MainWindow::PIXELS_PER_FLY).toInt());
+    this->ui->autoCalibrate->setChecked(settings.value(MainWindow::AUTO_CALIBRATE).toBool());
+    this->on_autoCalibrate_toggled(settings.value(MainWindow::AUTO_CALIBRATE).toBool());
     this->ui->threshold->setValue(settings.value(MainWindow::THRESHOLD).toInt());
     this->on_threshold_valueChanged(settings.value(MainWindow::THRESHOLD).toInt());
+    this->ui->thresholdMode->setCurrentIndex(settings.value(MainWindow::THRESHOLD_MODE).toInt());
+    this->on_thresholdMode_currentIndexChanged(settings.value(MainWindow::THRESHOLD_MODE).toInt());
+    this->ui->thresholdK->setValue(settings.value(MainWindow::THRESHOLD_K, 2.0).toDouble());
+    this->on_thresholdK_valueChanged(settings.value(MainWindow::THRESHOLD_K, 2.0).toDouble());
+    this->ui->backgroundFrames->setValue(settings.value(MainWindow::BACKGROUND_FRAMES).toInt());
+    this->on_backgroundFrames_valueChanged(settings.value(MainWindow::BACKGROUND_FRAMES).toInt());
     this->ui->vialSize->setValue(settings.value(MainWindow::VIAL_SIZE).toInt());
     this->on_vialSize_valueChanged(settings.value(MainWindow::VIAL_SIZE).toInt());
+    this->ui->vialDetection->setCurrentIndex(settings.value(MainWindow::VIAL_DETECTION).toInt());
+    this->on_vialDetection_currentIndexChanged(settings.value(MainWindow::VIAL_DETECTION).toInt());
+    this->ui->lensCalibration->setText(settings.value(MainWindow::LENS_CALIBRATION).toString());
+    this->on_lensCalibration_editingFinished();
     this->ui->outputPath->setText(settings.value(MainWindow::OUTPUT_PATH).toString());
     this->on_outputPath_textChanged(settings.value(MainWindow::OUTPUT_PATH).toString());
     this->ui->saveImages->setChecked(settings.value(MainWindow::SAVE_IMAGES).toBool());
     this->on_saveImages_toggled(settings.value(MainWindow::SAVE_IMAGES).toBool());
+    this->ui->trackFlies->setChecked(settings.value(MainWindow::TRACK_FLIES).toBool());
+    this->on_trackFlies_toggled(settings.value(MainWindow::TRACK_FLIES).toBool());
+    this->ui->syncInterval->setValue(settings.value(MainWindow::SYNC_INTERVAL, 10).toInt());
+    this->on_syncInterval_valueChanged(settings.value(MainWindow::SYNC_INTERVAL, 10).toInt());
+    this->ui->binaryLog->setChecked(settings.value(MainWindow::BINARY_LOG).toBool());
+    this->on_binaryLog_toggled(settings.value(MainWindow::BINARY_LOG).toBool());
+    this->ui->archiveMode->setCurrentIndex(settings.value(MainWindow::ARCHIVE_MODE).toInt());
+    this->on_archiveMode_currentIndexChanged(settings.value(MainWindow::ARCHIVE_MODE).toInt());
+    this->ui->trace->setChecked(settings.value(MainWindow::TRACE).toBool());
+    this->on_trace_toggled(settings.value(MainWindow::TRACE).toBool());
+
+    // the further racks take over the settings above, their own group overrides single values
+    this->rackSettings.clear();
+    for (int i = 1; i < RackController::MAX_RACKS; ++i)
+    {
+        QVariantMap values;
+        settings.beginGroup(QString("rack%1").arg(i));
+        for (const QString& key : settings.childKeys())
+        {
+            values[key] = settings.value(key);
+        }
+        settings.endGroup();
+        this->rackSettings.append(values);
+    }
 
     // disable display vials signal so that we do not render the image twice
     bool signalState = this->ui->displayVials->blockSignals(true);
@@ -244,13 +332,66 @@ void MainWindow::saveSettings(const QString& path)
     settings.setValue(MainWindow::ROUND_TIME,     this->ui->roundTime->value());
     settings.setValue(MainWindow::LEAD_TIME,      this->ui->leadTime->value());
     settings.setValue(MainWindow::SHAKE_TIME,     this->ui->shakeTime->value());
+    settings.setValue(MainWindow::BURST_FRAMES,   this->ui->burstFrames->value());
+    settings.setValue(MainWindow::BURST_RATE,     this->ui->burstRate->value());
+    settings.setValue(MainWindow::RACKS,          this->ui->racks->value());
+    settings.setValue(MainWindow::HEIGHT_LINE,    this->ui->heightLine->value());
     settings.setValue(MainWindow::EPSILON,        this->ui->epsilon->value());
     settings.setValue(MainWindow::MIN_POINTS,     this->ui->minPoints->value());
     settings.setValue(MainWindow::PIXELS_PER_FLY, this->ui->pixelsPerFly->value());
+    settings.setValue(MainWindow::AUTO_CALIBRATE, this->ui->autoCalibrate->isChecked());
     settings.setValue(MainWindow::THRESHOLD,      this->ui->threshold->value());
+    settings.setValue(MainWindow::THRESHOLD_MODE, this->ui->thresholdMode->currentIndex());
+    settings.setValue(MainWindow::THRESHOLD_K,    this->ui->thresholdK->value());
+    settings.setValue(MainWindow::BACKGROUND_FRAMES, this->ui->backgroundFrames->value());
     settings.setValue(MainWindow::VIAL_SIZE,      this->ui->vialSize->value());
+    settings.setValue(MainWindow::VIAL_DETECTION, this->ui->vialDetection->currentIndex());
+    settings.setValue(MainWindow::LENS_CALIBRATION, this->ui->lensCalibration->text());
     settings.setValue(MainWindow::OUTPUT_PATH,    this->ui->outputPath->text());
     settings.setValue(MainWindow::SAVE_IMAGES,    this->ui->saveImages->isChecked());
+    settings.setValue(MainWindow::TRACK_FLIES,    this->ui->trackFlies->isChecked());
+    settings.setValue(MainWindow::SYNC_INTERVAL,  this->ui->syncInterval->value());
+    settings.setValue(MainWindow::BINARY_LOG,     this->ui->binaryLog->isChecked());
+    settings.setValue(MainWindow::ARCHIVE_MODE,   this->ui->archiveMode->currentIndex());
+    settings.setValue(MainWindow::TRACE,          this->ui->trace->isChecked());
+
+    for (int i = 0; i < this->rackSettings.size(); ++i)
+    {
+        settings.beginGroup(QString("rack%1").arg(i + 1));
+        for (auto value = this->rackSettings[i].constBegin(); value != this->rackSettings[i].constEnd(); ++value)
+        {
+            settings.setValue(value.key(), value.value());
+        }
+        settings.endGroup();
+    }
+}
+
+/* applies the own settings of a further rack, the ones it does not set stay those of the primary rack */
+void MainWindow::configureRack(int index, FlyCounterController* rack)
+{
+    if (index < 1 || index > this->rackSettings.size()) return;
+    const QVariantMap& values = this->rackSettings[index - 1];
+
+    // round time needs to go first
+    if (values.contains(MainWindow::ROUND_TIME))        rack->validatedSetRoundTime(Seconds(values[MainWindow::ROUND_TIME].toInt()));
+    if (values.contains(MainWindow::LEAD_TIME))         rack->validatedSetLeadTime(Seconds(values[MainWindow::LEAD_TIME].toInt()));
+    if (values.contains(MainWindow::SHAKE_TIME))        rack->validatedSetShakeTime(Seconds(values[MainWindow::SHAKE_TIME].toInt()));
+    if (values.contains(MainWindow::BURST_FRAMES))      rack->setBurstFrames(values[MainWindow::BURST_FRAMES].toInt());
+    if (values.contains(MainWindow::BURST_RATE))        rack->setBurstRate(values[MainWindow::BURST_RATE].toInt());
+    if (values.contains(MainWindow::HEIGHT_LINE))       rack->setHeightLine(values[MainWindow::HEIGHT_LINE].toDouble());
+    if (values.contains(MainWindow::EPSILON))           rack->setEpsilon(values[MainWindow::EPSILON].toInt());
+    if (values.contains(MainWindow::MIN_POINTS))        rack->setMinPoints(values[MainWindow::MIN_POINTS].toInt());
+    if (values.contains(MainWindow::PIXELS_PER_FLY))    rack->setPixelsPerFly(values[MainWindow::PIXELS_PER_FLY].toInt());
+    if (values.contains(MainWindow::AUTO_CALIBRATE))    rack->setAutoCalibrate(values[MainWindow::AUTO_CALIBRATE].toBool());
+    if (values.contains(MainWindow::THRESHOLD))         rack->setThreshold(values[MainWindow::THRESHOLD].toInt());
+    if (values.contains(MainWindow::THRESHOLD_MODE))    rack->setThresholdMode(values[MainWindow::THRESHOLD_MODE].toInt());
+    if (values.contains(MainWindow::THRESHOLD_K))       rack->setThresholdK(values[MainWindow::THRESHOLD_K].toDouble());
+    if (values.contains(MainWindow::BACKGROUND_FRAMES)) rack->setBackgroundFrames(values[MainWindow::BACKGROUND_FRAMES].toInt());
+    if (values.contains(MainWindow::VIAL_SIZE))         rack->setVialSize(values[MainWindow::VIAL_SIZE].toInt());
+    if (values.contains(MainWindow::VIAL_DETECTION))    rack->setVialDetection(values[MainWindow::VIAL_DETECTION].toInt());
+
+    // the calibration is one of the rack's own camera, without one the frames are not corrected
+    rack->setLensCalibration(values.value(MainWindow::LENS_CALIBRATION).toString().toStdString());
 }
 
 /** public **/
@@ -328,6 +469,27 @@ void MainWindow::on_shakeTime_valueChanged(int time)
     this->updateTimeSpinners();
 }
 
+/* burst settings */
+void MainWindow::on_burstFrames_valueChanged(int frames)
+{
+    this->flyCounter.setBurstFrames(frames);
+}
+
+void MainWindow::on_burstRate_valueChanged(int rate)
+{
+    this->flyCounter.setBurstRate(rate);
+}
+
+void MainWindow::on_racks_valueChanged(int count)
+{
+    this->rackController.setRacks(count);
+}
+
+void MainWindow::on_heightLine_valueChanged(double line)
+{
+    this->flyCounter.setHeightLine(line);
+}
+
 /* analysis parameters */
 void MainWindow::on_epsilon_valueChanged(int epsilon)
 {
@@ -350,6 +512,11 @@ void MainWindow::on_pixelsPerFly_valueChanged(int pixelsPerFly)
     this->updateImage();
 }
 
+void MainWindow::on_autoCalibrate_toggled(bool checked)
+{
+    this->flyCounter.setAutoCalibrate(checked);
+}
+
 void MainWindow::on_threshold_valueChanged(int threshold)
 {
     this->flyCounter.setThreshold(threshold);
@@ -358,16 +525,66 @@ void MainWindow::on_threshold_valueChanged(int threshold)
     this->updateImage();
 }
 
+void MainWindow::on_thresholdMode_currentIndexChanged(int mode)
+{
+    this->flyCounter.setThresholdMode(mode);
+    this->flyCounter.updateThresholdImage();
+    this->flyCounter.updateClusterImage();
+    this->updateImage();
+}
+
+void MainWindow::on_thresholdK_valueChanged(double k)
+{
+    this->flyCounter.setThresholdK(k);
+    this->flyCounter.updateThresholdImage();
+    this->flyCounter.updateClusterImage();
+    this->updateImage();
+}
+
+/* number of rounds used to learn the static background at the start of an experiment, zero disables it */
+void MainWindow::on_backgroundFrames_valueChanged(int frames)
+{
+    this->flyCounter.setBackgroundFrames(frames);
+}
+
 void MainWindow::on_vialSize_valueChanged(int vialSize)
 {
     this->flyCounter.setVialSize(vialSize);
     if (!this->flyCounter.getCameraImage().empty()){
         this->flyCounter.updateVials();
+        this->flyCounter.updateThresholdImage();
         this->flyCounter.updateClusterImage();
         this->updateImage();
     }
 }
 
+/* green screen contours or circles, the latter need no backdrop */
+void MainWindow::on_vialDetection_currentIndexChanged(int detection)
+{
+    this->flyCounter.setVialDetection(detection);
+    if (!this->flyCounter.getCameraImage().empty()){
+        this->flyCounter.updateVials();
+        this->flyCounter.updateThresholdImage();
+        this->flyCounter.updateClusterImage();
+        this->updateImage();
+    }
+}
+
+/* camera calibration written by tools/calibrate.py, vials and flies are analyzed in the corrected image */
+void MainWindow::on_lensCalibrationBrowser_clicked()
+{
+    QString path = QFileDialog::getOpenFileName(this, "Lens calibration", QStandardPaths::writableLocation(QStandardPaths::DocumentsLocation), "Calibrations (*.yml *.yaml *.xml)");
+    if (path.isEmpty()) return;
+    this->ui->lensCalibration->setText(path);
+    this->on_lensCalibration_editingFinished();
+}
+
+/* applied once the path is complete, not for every typed character */
+void MainWindow::on_lensCalibration_editingFinished()
+{
+    this->flyCounter.setLensCalibration(this->ui->lensCalibration->text().toStdString());
+}
+
 /* result settings */
 void MainWindow::on_outputPathBrowser_clicked()
 {
@@ -387,22 +604,80 @@ void MainWindow::on_saveImages_toggled(bool checked)
     this->flyCounter.storeImages(checked);
 }
 
+void MainWindow::on_trackFlies_toggled(bool checked)
+{
+    this->flyCounter.setTracking(checked);
+}
+
+void MainWindow::on_syncInterval_valueChanged(int rounds)
+{
+    this->flyCounter.setSyncInterval(rounds);
+}
+
+void MainWindow::on_binaryLog_toggled(bool checked)
+{
+    this->flyCounter.setBinaryLog(checked);
+}
+
+void MainWindow::on_archiveMode_currentIndexChanged(int mode)
+{
+    this->flyCounter.setArchiveMode(mode);
+}
+
+void MainWindow::on_trace_toggled(bool checked)
+{
+    this->flyCounter.setTrace(checked);
+}
+
 /* experiment execution */
 void MainWindow::on_start_clicked()
 {
     this->userInterfaceEnabled(false);
-    this->flyCounter.start();
+    this->rackController.start();
 }
 
 void MainWindow::on_stop_clicked()
 {
     this->userInterfaceEnabled(true);
-    this->flyCounter.stop();
+    this->rackController.stop();
 }
 
 void MainWindow::updateImage()
 {
     this->on_mode_currentIndexChanged(this->getViewMode());
+    this->updateTiming();
+}
+
+/* displays the messages logged since the last call, other threads only queue them */
+void MainWindow::updateLog()
+{
+    Logger::flush();
+}
+
+/* shows the rolling stage statistics of the profiler, one row per stage */
+void MainWindow::updateTiming()
+{
+    if (!this->ui->timingDock->isVisible()) return;
+
+    const StageTimings timings = Profiler::summary();
+    this->ui->timing->setRowCount((int)timings.size());
+    for (int row = 0; row < (int)timings.size(); ++row)
+    {
+        const StageTiming& timing = timings[row];
+        this->ui->timing->setItem(row, 0, new QTableWidgetItem(QString::fromStdString(timing.stage)));
+        this->ui->timing->setItem(row, 1, new QTableWidgetItem(QString::number(timing.last, 'f', 1)));
+        this->ui->timing->setItem(row, 2, new QTableWidgetItem(QString::number(timing.p50,  'f', 1)));
+        this->ui->timing->setItem(row, 3, new QTableWidgetItem(QString::number(timing.p95,  'f', 1)));
+        this->ui->timing->setItem(row, 4, new QTableWidgetItem(QString::number(timing.max,  'f', 1)));
+    }
+}
+
+/* reflect a calibrated pixels per fly value in the interface without re-running the analysis */
+void MainWindow::updatePixelsPerFly(int pixelsPerFly)
+{
+    bool signalState = this->ui->pixelsPerFly->blockSignals(true);
+    this->ui->pixelsPerFly->setValue(pixelsPerFly);
+    this->ui->pixelsPerFly->blockSignals(signalState);
 }
 
 void MainWindow::on_actionLoad_triggered()
@@ -423,9 +698,10 @@ void MainWindow::on_actionSave_triggered()
 
 MainWindow::~MainWindow()
 {
-    this->flyCounter.stop();
+    this->rackController.stop();
     this->saveSettings(DEFAULT_PATH);
 
+    Logger::setOutput(nullptr);
     delete this->ui;
 }
 
@@ -434,3 +710,9 @@ void MainWindow::on_actionShow_Log_toggled(bool arg1)
 
     arg1 ? this->ui->messageDock->show() : this->ui->messageDock->hide();
 }
+
+void MainWindow::on_actionShow_Timing_toggled(bool checked)
+{
+    checked ? this->ui->timingDock->show() : this->ui->timingDock->hide();
+    this->updateTiming();
+}
@@ -2,12 +2,15 @@
 #define MAINWINDOW_H
 
 #include <QGraphicsScene>
+#include <QList>
 #include <QMainWindow>
 #include <QString>
+#include <QVariantMap>
 
 #include <opencv2/opencv.hpp>
 
 #include "flycountercontroller.h"
+#include "rackcontroller.h"
 
 /* view type set */
 enum ViewMode
@@ -32,6 +35,8 @@ private:
     QPixmap         image;
     QGraphicsScene* scene;
     FlyCounterController      flyCounter;
+    RackController            rackController;
+    QList<QVariantMap>        rackSettings; // own settings of the further racks, the "rack<N>" groups of the settings file
 
     /* initialization */
     void setupUI();
@@ -48,18 +53,23 @@ private:
 
     /* interface updates */
     void updateTimeSpinners();
+    void updateTiming();
     void userInterfaceEnabled(bool enabled);
 
     /* settings loading/saving */
     void loadSettings(const QString& path);
     void saveSettings(const QString& path);
+    void configureRack(int index, FlyCounterController* rack);
 
 private slots:
     void onLoadResize();
     void resizeEvent(QResizeEvent* event);
     void updateImage();
+    void updateLog();
+    void updatePixelsPerFly(int pixelsPerFly);
 
     void on_actionShow_Log_toggled(bool arg1);
+    void on_actionShow_Timing_toggled(bool checked);
 
 public:
     static const QString DEFAULT_PATH;
@@ -69,13 +79,28 @@ public:
     static const QString LEAD_TIME;
     static const QString ROUND_TIME;
     static const QString SHAKE_TIME;
+    static const QString BURST_FRAMES;
+    static const QString BURST_RATE;
+    static const QString RACKS;
+    static const QString HEIGHT_LINE;
     static const QString EPSILON;
     static const QString MIN_POINTS;
     static const QString PIXELS_PER_FLY;
+    static const QString AUTO_CALIBRATE;
     static const QString THRESHOLD;
+    static const QString THRESHOLD_MODE;
+    static const QString THRESHOLD_K;
+    static const QString BACKGROUND_FRAMES;
     static const QString VIAL_SIZE;
+    static const QString VIAL_DETECTION;
+    static const QString LENS_CALIBRATION;
     static const QString OUTPUT_PATH;
     static const QString SAVE_IMAGES;
+    static const QString TRACK_FLIES;
+    static const QString SYNC_INTERVAL;
+    static const QString BINARY_LOG;
+    static const QString ARCHIVE_MODE;
+    static const QString TRACE;
 
     explicit MainWindow(QWidget* parent=nullptr);
 
@@ -95,18 +120,34 @@ public slots:
     void on_leadTime_valueChanged(int time);
     void on_roundTime_valueChanged(int time);
     void on_shakeTime_valueChanged(int time);
+    void on_burstFrames_valueChanged(int frames);
+    void on_burstRate_valueChanged(int rate);
+    void on_racks_valueChanged(int count);
+    void on_heightLine_valueChanged(double line);
 
     /* analysis parameter setters */
     void on_epsilon_valueChanged(int epsilon);
     void on_minPoints_valueChanged(int minPoints);
     void on_pixelsPerFly_valueChanged(int pixelsPerFly);
+    void on_autoCalibrate_toggled(bool checked);
     void on_threshold_valueChanged(int threshold);
+    void on_thresholdMode_currentIndexChanged(int mode);
+    void on_thresholdK_valueChanged(double k);
+    void on_backgroundFrames_valueChanged(int frames);
     void on_vialSize_valueChanged(int arg1);
+    void on_vialDetection_currentIndexChanged(int detection);
+    void on_lensCalibrationBrowser_clicked();
+    void on_lensCalibration_editingFinished();
 
     /* results */
     void on_outputPath_textChanged(const QString& path);
     void on_outputPathBrowser_clicked();
     void on_saveImages_toggled(bool checked);
+    void on_trackFlies_toggled(bool checked);
+    void on_syncInterval_valueChanged(int rounds);
+    void on_binaryLog_toggled(bool checked);
+    void on_archiveMode_currentIndexChanged(int mode);
+    void on_trace_toggled(bool checked);
 
     /* experiment execution */
     void on_start_clicked();
@@ -0,0 +1,70 @@
+#include "profiler.h"
+
+#include <algorithm>
+
+std::mutex                               Profiler::lock;
+std::map<std::string, Profiler::Samples> Profiler::stages;
+
+void Profiler::record(const char* stage, double milliseconds)
+{
+    std::lock_guard<std::mutex> guard(Profiler::lock);
+    Samples& samples = Profiler::stages[stage];
+
+    if (samples.window.size() < WINDOW)
+    {
+        samples.window.push_back(milliseconds);
+    }
+    else
+    {
+        samples.window[samples.next] = milliseconds;
+    }
+    samples.next   = (samples.next + 1) % WINDOW;
+    samples.last   = milliseconds;
+    samples.total += milliseconds;
+    ++samples.calls;
+}
+
+static double percentile(std::vector<double>& values, double fraction)
+{
+    size_t rank = std::min((size_t)(fraction * values.size()), values.size() - 1);
+    std::nth_element(values.begin(), values.begin() + rank, values.end());
+    return values[rank];
+}
+
+StageTimings Profiler::summary(bool reset)
+{
+    StageTimings timings;
+    std::vector<double> values;
+
+    std::lock_guard<std::mutex> guard(Profiler::lock);
+    for (auto& stage : Profiler::stages)
+    {
+        Samples& samples = stage.second;
+        if (samples.window.empty()) continue;
+
+        StageTiming timing;
+        timing.stage = stage.first;
+        timing.calls = samples.calls;
+        timing.total = samples.total;
+        timing.last  = samples.last;
+
+        values = samples.window;
+        timing.p50 = percentile(values, 0.50);
+        timing.p95 = percentile(values, 0.95);
+        timing.max = *std::max_element(values.begin(), values.end());
+        timings.push_back(timing);
+
+        if (reset)
+        {
+            samples.calls = 0;
+            samples.total = 0.0;
+        }
+    }
+    return timings;
+}
+
+void Profiler::clear()
+{
+    std::lock_guard<std::mutex> guard(Profiler::lock);
+    Profiler::stages.clear();
+}
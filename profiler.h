@@ -0,0 +1,73 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "timer.h"
+#include "tracer.h"
+
+/* statistics of one pipeline stage in milliseconds */
+struct StageTiming
+{
+    std::string stage;
+    long        calls;  // since the last reset
+    double      total;  // since the last reset
+    double      last;
+    double      p50;    // of the rolling window
+    double      p95;
+    double      max;
+};
+
+typedef std::vector<StageTiming> StageTimings;
+
+/* Collects the durations of the pipeline stages in rolling windows, thread-safe */
+class Profiler
+{
+private:
+    struct Samples
+    {
+        std::vector<double> window;
+        size_t              next;
+        long                calls;
+        double              total;
+        double              last;
+        Samples() : next(0), calls(0), total(0.0), last(0.0) {}
+    };
+
+    static std::mutex                     lock;
+    static std::map<std::string, Samples> stages;
+
+public:
+    static const size_t WINDOW = 200; // samples per stage
+
+    static void record(const char* stage, double milliseconds);
+
+    /* Statistics of all stages seen so far, reset starts a new interval for calls and total */
+    static StageTimings summary(bool reset=false);
+    static void clear();
+};
+
+/* Records the lifetime of the object as one sample of the stage and as a trace span, the name must be a literal */
+class ScopedTimer
+{
+private:
+    const char* stage;
+    Timepoint   start;
+
+    ScopedTimer(const ScopedTimer&);
+    ScopedTimer& operator=(const ScopedTimer&);
+
+public:
+    explicit ScopedTimer(const char* name) : stage(name), start(Clock::now()) {}
+    ~ScopedTimer()
+    {
+        Timepoint end = Clock::now();
+        Profiler::record(this->stage, std::chrono::duration<double, std::milli>(end - this->start).count());
+        if (Tracer::isEnabled()) Tracer::complete(this->stage, this->start, end);
+    }
+};
+
+#endif // PROFILER_H
@@ -0,0 +1,105 @@
+#include "rackcontroller.h"
+
+#include <algorithm>
+#include <thread>
+
+#include "logger.h"
+
+RackController::RackController(FlyCounterController* primary)
+:
+racks(1, primary),
+analysis(nullptr)
+{
+
+}
+
+int RackController::getRacks()
+{
+    return (int)this->racks.size();
+}
+
+void RackController::setRacks(int count)
+{
+    count = std::min(std::max(count, 1), MAX_RACKS);
+    if (count == this->getRacks()) return;
+
+    while (this->getRacks() > count)
+    {
+        delete this->racks.back();
+        this->racks.pop_back();
+    }
+    while (this->getRacks() < count)
+    {
+        FlyCounterController* rack = new FlyCounterController();
+        rack->setRack(this->getRacks());
+        rack->detectDevices();
+        this->racks.push_back(rack);
+    }
+
+    // one worker per rack at most, a single rack analyzes on its own thread
+    delete this->analysis;
+    this->analysis = nullptr;
+    if (count > 1)
+    {
+        this->analysis = new AnalysisPool(std::min(count, (int)std::max(std::thread::hardware_concurrency(), 1u)));
+    }
+    for (int i = 0; i < count; ++i)
+    {
+        this->racks[i]->setAnalysisPool(this->analysis);
+    }
+    this->racks.front()->setRack(count > 1 ? 0 : -1);
+
+    Logger::info(QString("Running %1 rack(s)").arg(count));
+}
+
+FlyCounterController* RackController::getRack(int index)
+{
+    return this->racks.at(index);
+}
+
+void RackController::setConfiguration(const Configuration& configure)
+{
+    this->configuration = configure;
+}
+
+void RackController::start()
+{
+    FlyCounterController* primary = this->racks.front();
+    const int count = this->getRacks();
+
+    // staggered rounds so that the analyses of the racks do not pile up
+    for (int i = 0; i < count; ++i)
+    {
+        FlyCounterController* rack = this->racks[i];
+        if (i > 0)
+        {
+            rack->copySettings(*primary);
+            if (this->configuration) this->configuration(i, rack);
+        }
+        rack->setStartOffset(std::chrono::duration_cast<Clock::duration>(rack->getRoundTime()) * i / count);
+    }
+    for (FlyCounterController* rack : this->racks)
+    {
+        rack->start();
+    }
+}
+
+/* the primary rack owns the process wide outputs and stops last */
+void RackController::stop()
+{
+    for (int i = this->getRacks() - 1; i >= 0; --i)
+    {
+        this->racks[i]->stop();
+    }
+}
+
+RackController::~RackController()
+{
+    this->stop();
+    for (size_t i = 1; i < this->racks.size(); ++i)
+    {
+        delete this->racks[i];
+    }
+    this->racks.front()->setAnalysisPool(nullptr);
+    delete this->analysis;
+}
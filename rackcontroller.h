@@ -0,0 +1,42 @@
+#ifndef RACKCONTROLLER_H
+#define RACKCONTROLLER_H
+
+#include <functional>
+#include <vector>
+
+#include "analysispool.h"
+#include "flycountercontroller.h"
+
+/* Runs several racks, each with its own camera, shaker and schedule, from one process.
+   The first rack is the one configured and shown by the GUI, the others take over its settings on start
+   and then apply their own ones through the configuration callback. */
+class RackController
+{
+public:
+    /* sets the own settings of the rack with the given index on top of the primary ones */
+    typedef std::function<void(int, FlyCounterController*)> Configuration;
+
+protected:
+    std::vector<FlyCounterController*> racks; // the primary rack first, the others are owned
+    AnalysisPool*                      analysis;
+    Configuration                      configuration;
+
+public:
+    static const int MAX_RACKS = 8;
+
+    explicit RackController(FlyCounterController* primary);
+
+    int getRacks();
+    /* adds or removes racks, added ones detect the camera and shaker of their index */
+    void setRacks(int count);
+    FlyCounterController* getRack(int index);
+    void setConfiguration(const Configuration& configure);
+
+    /* starts all racks with the settings of the primary one and their own, their rounds are spread evenly over the round time */
+    void start();
+    void stop();
+
+    ~RackController();
+};
+
+#endif // RACKCONTROLLER_H
@@ -0,0 +1,165 @@
+#include "racklayout.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <numeric>
+
+static const float LINE_TOLERANCE  = 0.5f;  // of the vial spacing, centers closer than this along an axis share a line
+static const float ANGLE_TOLERANCE = 0.05f; // rad, grids rotated less than this against each other share their origin
+
+/* median distance to the nearest neighbour and the grid rotation, the neighbour directions are folded to a quarter turn */
+static float neighbourSpacing(const Vials& vials, float& angle)
+{
+    std::vector<float> distances;
+    distances.reserve(vials.size());
+    double sine   = 0.0;
+    double cosine = 0.0;
+
+    for (size_t i = 0; i < vials.size(); ++i)
+    {
+        float     nearest = FLT_MAX;
+        cv::Point direction;
+        for (size_t j = 0; j < vials.size(); ++j)
+        {
+            if (i == j) continue;
+            cv::Point offset   = vials[j].center - vials[i].center;
+            float     distance = (float)std::sqrt((double)offset.dot(offset));
+            if (distance > 0.0f && distance < nearest)
+            {
+                nearest   = distance;
+                direction = offset;
+            }
+        }
+        if (nearest == FLT_MAX) continue;
+
+        double theta = 4.0 * std::atan2((double)direction.y, (double)direction.x);
+        sine   += std::sin(theta);
+        cosine += std::cos(theta);
+        distances.push_back(nearest);
+    }
+
+    angle = (float)(std::atan2(sine, cosine) / 4.0);
+    if (distances.empty()) return 0.0f;
+
+    std::nth_element(distances.begin(), distances.begin() + distances.size() / 2, distances.end());
+    return distances[distances.size() / 2];
+}
+
+/* groups coordinates along one axis into lines and numbers the lines by their distance in pitches from the origin,
+   gaps of several pitches are empty lines of the rack. The origin is the first line unless an anchor is passed,
+   it is moved back to the first line if that lies before the anchor. */
+static int lineIndices(const std::vector<float>& coordinates, float spacing, const float* anchor, std::vector<int>& indices, float& pitch, float& origin)
+{
+    std::vector<size_t> order(coordinates.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return coordinates[a] < coordinates[b]; });
+
+    std::vector<int>   line(coordinates.size());
+    std::vector<float> means;
+    float sum     = 0.0f;
+    int   members = 0;
+    for (size_t k = 0; k < order.size(); ++k)
+    {
+        float coordinate = coordinates[order[k]];
+        if (members > 0 && coordinate - coordinates[order[k - 1]] > spacing * LINE_TOLERANCE)
+        {
+            means.push_back(sum / members);
+            sum     = 0.0f;
+            members = 0;
+        }
+        line[order[k]] = (int)means.size();
+        sum += coordinate;
+        ++members;
+    }
+    if (members > 0)
+    {
+        means.push_back(sum / members);
+    }
+
+    // the median gap between neighbouring lines is the pitch, missing lines only make some gaps larger
+    std::vector<float> gaps;
+    for (size_t i = 1; i < means.size(); ++i)
+    {
+        gaps.push_back(means[i] - means[i - 1]);
+    }
+    pitch = spacing;
+    if (!gaps.empty())
+    {
+        std::nth_element(gaps.begin(), gaps.begin() + gaps.size() / 2, gaps.end());
+        pitch = gaps[gaps.size() / 2];
+    }
+
+    origin = means.empty() ? 0.0f : means[0];
+    int first = 0;
+    if (anchor != nullptr && !means.empty())
+    {
+        first = std::max((int)std::lround((means[0] - *anchor) / pitch), 0);
+        origin = first > 0 ? *anchor : means[0];
+    }
+
+    std::vector<int> numbers(means.size(), first);
+    for (size_t i = 1; i < means.size(); ++i)
+    {
+        numbers[i] = std::max(numbers[i - 1] + 1, first + (int)std::lround((means[i] - means[0]) / pitch));
+    }
+
+    indices.resize(coordinates.size());
+    for (size_t i = 0; i < coordinates.size(); ++i)
+    {
+        indices[i] = numbers[line[i]];
+    }
+    return means.empty() ? 0 : numbers.back() + 1;
+}
+
+RackLayout fitRackLayout(Vials& vials, const RackLayout* previous)
+{
+    RackLayout layout;
+    if (vials.empty()) return previous != nullptr ? *previous : layout;
+
+    float spacing = neighbourSpacing(vials, layout.angle);
+    if (spacing <= 0.0f)
+    {
+        spacing = 1.0f;
+    }
+
+    // centers in grid coordinates, i.e. rotated back by the grid angle
+    const float cosine = std::cos(layout.angle);
+    const float sine   = std::sin(layout.angle);
+    std::vector<float> xs(vials.size());
+    std::vector<float> ys(vials.size());
+    for (size_t i = 0; i < vials.size(); ++i)
+    {
+        xs[i] =  vials[i].center.x * cosine + vials[i].center.y * sine;
+        ys[i] = -vials[i].center.x * sine   + vials[i].center.y * cosine;
+    }
+
+    // the origin of the previous grid only anchors a grid of about the same rotation
+    const bool anchored = previous != nullptr && previous->rows > 0 && previous->columns > 0 && std::abs(previous->angle - layout.angle) < ANGLE_TOLERANCE;
+
+    std::vector<int> columns;
+    std::vector<int> rows;
+    layout.columns = lineIndices(xs, spacing, anchored ? &previous->columnOrigin : nullptr, columns, layout.columnPitch, layout.columnOrigin);
+    layout.rows    = lineIndices(ys, spacing, anchored ? &previous->rowOrigin    : nullptr, rows,    layout.rowPitch,    layout.rowOrigin);
+
+    for (size_t i = 0; i < vials.size(); ++i)
+    {
+        vials[i].row    = rows[i];
+        vials[i].column = columns[i];
+    }
+    std::stable_sort(vials.begin(), vials.end(), compareVials);
+
+    return layout;
+}
+
+std::string vialName(int row, int column)
+{
+    if (row < 0 || column < 0) return "?";
+
+    std::string name;
+    for (int i = row; i >= 0; i = i / 26 - 1)
+    {
+        name.insert(name.begin(), (char)('A' + i % 26));
+    }
+    return name + std::to_string(column + 1);
+}
@@ -0,0 +1,39 @@
+#ifndef RACKLAYOUT_H
+#define RACKLAYOUT_H
+
+#include <string>
+
+#include "vials.h"
+
+/* Grid of the vials in a rack, rows run along the x axis of the grid which may be rotated against the image */
+struct RackLayout
+{
+    int   rows;
+    int   columns;
+    float angle;       // rad, rotation of the grid against the image axes within [-pi/4, pi/4]
+    float rowPitch;    // px between neighbouring rows
+    float columnPitch; // px between neighbouring columns
+    float rowOrigin;   // grid coordinate of row 0
+    float columnOrigin;
+
+    RackLayout():
+        rows(0),
+        columns(0),
+        angle(0.0f),
+        rowPitch(0.0f),
+        columnPitch(0.0f),
+        rowOrigin(0.0f),
+        columnOrigin(0.0f)
+    {}
+};
+
+/* Fits the grid to the vial centers, assigns the row and column of every vial and sorts the vials row by row.
+   Positions are quantized by the pitch so that the ids stay the same for jittering detections and empty slots.
+   Without a previous layout the first detected row and column are number 0, so ids only survive inner gaps.
+   With the layout of the previous frame the lines are numbered from its origin, so that whole missing outer
+   rows or columns keep the ids as well; lines before that origin renumber the grid. */
+RackLayout  fitRackLayout(Vials& vials, const RackLayout* previous=nullptr);
+/* Spreadsheet like name of a grid position - A1, B12, ..., Z3, AA3 */
+std::string vialName(int row, int column);
+
+#endif // RACKLAYOUT_H
@@ -1,9 +1,55 @@
 #include <fcntl.h>
+#include <fstream>
 #include <iostream>
+#include <iterator>
+
+#include <gphoto2/gphoto2.h>
 
 #include "reflexcam.h"
 
-ReflexCam::ReflexCam() : cam(nullptr), context(nullptr)
+/* binds the camera to the model and port of the index-th autodetected camera, gphoto2 picks the first one otherwise */
+bool ReflexCam::selectCamera(int index)
+{
+    CameraList* cameras;
+    if (gp_list_new(&cameras) != GP_OK) return false;
+
+    const char* model = nullptr;
+    const char* port  = nullptr;
+    bool selected = gp_camera_autodetect(cameras, this->context) > index &&
+                    gp_list_get_name(cameras, index, &model) == GP_OK &&
+                    gp_list_get_value(cameras, index, &port) == GP_OK;
+
+    if (selected)
+    {
+        CameraAbilitiesList* abilitiesList = nullptr;
+        CameraAbilities      abilities;
+        int modelIndex;
+        selected = gp_abilities_list_new(&abilitiesList) == GP_OK &&
+                   gp_abilities_list_load(abilitiesList, this->context) == GP_OK &&
+                   (modelIndex = gp_abilities_list_lookup_model(abilitiesList, model)) >= GP_OK &&
+                   gp_abilities_list_get_abilities(abilitiesList, modelIndex, &abilities) == GP_OK &&
+                   gp_camera_set_abilities(this->cam, abilities) == GP_OK;
+        if (abilitiesList != nullptr) gp_abilities_list_free(abilitiesList);
+    }
+
+    if (selected)
+    {
+        GPPortInfoList* ports = nullptr;
+        GPPortInfo      info;
+        int portIndex;
+        selected = gp_port_info_list_new(&ports) == GP_OK &&
+                   gp_port_info_list_load(ports) >= GP_OK &&
+                   (portIndex = gp_port_info_list_lookup_path(ports, port)) >= GP_OK &&
+                   gp_port_info_list_get_info(ports, portIndex, &info) == GP_OK &&
+                   gp_camera_set_port_info(this->cam, info) == GP_OK;
+        if (ports != nullptr) gp_port_info_list_free(ports);
+    }
+
+    gp_list_free(cameras);
+    return selected;
+}
+
+ReflexCam::ReflexCam(int index) : cam(nullptr), context(nullptr), filename(index == 0 ? "temp" : "temp" + std::to_string(index))
 {
     int error;
 
@@ -21,6 +67,14 @@ ReflexCam::ReflexCam() : cam(nullptr), context(nullptr)
         return;
     }
 
+    if (index > 0 && !this->selectCamera(index))
+    {
+        gp_camera_free(this->cam);
+        this->cam = nullptr;
+        this->accessable = false;
+        return;
+    }
+
     error = gp_camera_init(this->cam, this->context);
     if (error != GP_OK) {
         gp_camera_free(this->cam);
@@ -35,26 +89,45 @@ ReflexCam::ReflexCam() : cam(nullptr), context(nullptr)
 
 bool ReflexCam::getImage(cv::Mat& mat)
 {
-    const char filename[] = "temp";
+    const char* filename = this->filename.c_str();
     CameraFile* file;
     CameraFilePath camera_file_path;
 
     // TODO: what happens if camera is deconnected mid process?
     gp_camera_capture(cam, GP_CAPTURE_IMAGE, &camera_file_path, this->context);
-    int fd = open(filename, O_CREAT | O_WRONLY, 0644);
+    int fd = open(filename, O_CREAT | O_WRONLY | O_TRUNC, 0644);
     gp_file_new_from_fd(&file, fd);
     gp_camera_file_get(this->cam, camera_file_path.folder, camera_file_path.name, GP_FILE_TYPE_NORMAL, file, this->context);
     gp_camera_file_delete(this->cam, camera_file_path.folder, camera_file_path.name, this->context);
-    
-    mat = cv::imread(filename);
+    gp_file_unref(file);
+
+    // keep the JPEG bytes around so archiving does not need to re-encode the image
+    std::ifstream input(filename, std::ios::binary);
+    this->encoded.assign(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>());
+    if (this->encoded.empty())
+    {
+        mat = cv::Mat();
+        return false;
+    }
+
+    mat = cv::imdecode(this->encoded, cv::IMREAD_COLOR);
     if (mat.empty())
     {
+        this->encoded.clear();
         return false;
     }
 
     return true;
 }
 
+bool ReflexCam::getEncoded(std::vector<uchar>& data)
+{
+    if (this->encoded.empty()) return false;
+
+    data = this->encoded;
+    return true;
+}
+
 ReflexCam::~ReflexCam()
 {
     if (this->context)
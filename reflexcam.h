@@ -1,6 +1,9 @@
 #ifndef REFLEXCAM_H
 #define REFLEXCAM_H
 
+#include <string>
+#include <vector>
+
 #include <gphoto2/gphoto2-camera.h>
 #include <opencv2/opencv.hpp>
 
@@ -11,10 +14,16 @@ class ReflexCam : public Cam
 protected:
     Camera*    cam;
     GPContext* context;
+    std::string filename; // capture download, one per camera
+    std::vector<uchar> encoded;
+
+    bool selectCamera(int index);
 
 public:
-    ReflexCam();
+    /* the index selects one of several connected cameras, e.g. one per rack */
+    ReflexCam(int index=0);
     virtual bool getImage(cv::Mat& mat);
+    virtual bool getEncoded(std::vector<uchar>& data);
     virtual ~ReflexCam();
 };
 
@@ -0,0 +1,96 @@
+#include "resultwriter.h"
+
+#include <unistd.h>
+
+ResultWriter::ResultWriter()
+:
+file(nullptr),
+pending(0),
+syncInterval(1)
+{
+
+}
+
+bool ResultWriter::open(const std::string& filename)
+{
+    this->close();
+
+    this->file = std::fopen(filename.c_str(), "a");
+    if (this->file == nullptr)
+    {
+        return false;
+    }
+    std::setvbuf(this->file, nullptr, _IOFBF, BUFFER_SIZE);
+    this->path    = filename;
+    this->pending = 0;
+
+    return true;
+}
+
+bool ResultWriter::isOpen() const
+{
+    return this->file != nullptr;
+}
+
+void ResultWriter::close()
+{
+    if (this->file == nullptr) return;
+
+    this->sync();
+    std::fclose(this->file);
+    this->file = nullptr;
+}
+
+void ResultWriter::write(const std::string& text)
+{
+    this->write(text.data(), text.size());
+}
+
+void ResultWriter::write(const char* text, size_t length)
+{
+    if (this->file == nullptr) return;
+
+    std::fwrite(text, 1, length, this->file);
+}
+
+void ResultWriter::endRound()
+{
+    if (this->file == nullptr) return;
+
+    if (++this->pending >= this->syncInterval)
+    {
+        this->sync();
+    }
+}
+
+/* pushes the buffered data to the kernel and waits until it is on disk */
+void ResultWriter::sync()
+{
+    if (this->file == nullptr) return;
+
+    std::fflush(this->file);
+    fsync(fileno(this->file));
+    this->pending = 0;
+}
+
+/* getters */
+const std::string& ResultWriter::getPath() const
+{
+    return this->path;
+}
+
+int ResultWriter::getSyncInterval() const
+{
+    return this->syncInterval;
+}
+
+/* setters */
+void ResultWriter::setSyncInterval(int value)
+{
+    this->syncInterval = value > 0 ? value : 1;
+}
+
+ResultWriter::~ResultWriter()
+{
+    this->close();
+}
@@ -0,0 +1,46 @@
+#ifndef RESULTWRITER_H
+#define RESULTWRITER_H
+
+#include <cstdio>
+#include <string>
+
+/* Append-only result file that stays open for the whole experiment and is synced to disk every few rounds */
+class ResultWriter
+{
+protected:
+    std::FILE*  file;
+    std::string path;
+    int         pending;      // rounds written since the last sync
+    int         syncInterval; // rounds
+
+    ResultWriter(const ResultWriter&);
+    ResultWriter& operator=(const ResultWriter&);
+
+public:
+    static const size_t BUFFER_SIZE = 1 << 16; // bytes
+
+    ResultWriter();
+
+    bool open(const std::string& filename);
+    bool isOpen() const;
+    void close();
+
+    /* Buffered output, nothing reaches the disk before the next sync */
+    void write(const std::string& text);
+    void write(const char* text, size_t length);
+
+    /* Marks the end of a round, syncs the file if the interval is reached */
+    void endRound();
+    void sync();
+
+    /* Getters */
+    const std::string& getPath() const;
+    int getSyncInterval() const;
+
+    /* Setters */
+    void setSyncInterval(int value);
+
+    ~ResultWriter();
+};
+
+#endif // RESULTWRITER_H
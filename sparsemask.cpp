@@ -0,0 +1,94 @@
+#include "sparsemask.h"
+
+#include <cstdint>
+#include <cstring>
+
+void extractRuns(const cv::Mat& thresh, const Vial& vial, Runs& runs)
+{
+    cv::Rect roi = vial.bounds & cv::Rect(0, 0, thresh.cols, thresh.rows);
+    for (int y = roi.y; y < roi.y + roi.height; ++y)
+    {
+        const Span& span = vial.spans[y - vial.bounds.y];
+        const uchar* row = thresh.ptr<uchar>(y);
+        int end = std::min(span[1], roi.x + roi.width);
+        for (int x = std::max(span[0], roi.x); x < end; ++x)
+        {
+            if (!row[x]) continue;
+
+            int begin = x;
+            while (x < end && row[x]) ++x;
+            runs.push_back(Run(y, begin, x));
+        }
+    }
+}
+
+void drawRuns(const Runs& runs, cv::Mat& mask)
+{
+    for (const Run& run : runs)
+    {
+        std::memset(mask.ptr<uchar>(run.row) + run.begin, 255, run.length());
+    }
+}
+
+cv::Mat renderMask(const Vials& vials, const cv::Size& size)
+{
+    cv::Mat mask = cv::Mat::zeros(size, CV_8UC1);
+    for (const Vial& vial : vials)
+    {
+        drawRuns(vial.runs, mask);
+    }
+    return mask;
+}
+
+void runsToPoints(const Runs& runs, cv::Mat& points)
+{
+    points.create(countPixels(runs), 1, CV_32FC2);
+
+    cv::Point2f* point = points.ptr<cv::Point2f>();
+    for (const Run& run : runs)
+    {
+        for (int x = run.begin; x < run.end; ++x)
+        {
+            *point++ = cv::Point2f((float)x, (float)run.row);
+        }
+    }
+}
+
+int countPixels(const Runs& runs)
+{
+    int pixels = 0;
+    for (const Run& run : runs)
+    {
+        pixels += run.length();
+    }
+    return pixels;
+}
+
+/* little endian layout: 8 byte magic, uint32 width, uint32 height, uint32 number of runs, then uint16 row, begin, end per run */
+std::vector<uchar> encodeMask(const Vials& vials, const cv::Size& size)
+{
+    static const char MAGIC[] = "FLYMASK1";
+
+    uint32_t count = 0;
+    for (const Vial& vial : vials)
+    {
+        count += (uint32_t)vial.runs.size();
+    }
+
+    std::vector<uchar> data(8 + 3 * sizeof(uint32_t) + count * 3 * sizeof(uint16_t));
+    uint32_t header[3] = {(uint32_t)size.width, (uint32_t)size.height, count};
+    std::memcpy(data.data(), MAGIC, 8);
+    std::memcpy(data.data() + 8, header, sizeof(header));
+
+    uint16_t* record = reinterpret_cast<uint16_t*>(data.data() + 8 + sizeof(header));
+    for (const Vial& vial : vials)
+    {
+        for (const Run& run : vial.runs)
+        {
+            *record++ = (uint16_t)run.row;
+            *record++ = (uint16_t)run.begin;
+            *record++ = (uint16_t)run.end;
+        }
+    }
+    return data;
+}
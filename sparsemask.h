@@ -0,0 +1,26 @@
+#ifndef SPARSEMASK_H
+#define SPARSEMASK_H
+
+#include <string>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "vials.h"
+
+/* Helpers for the run-length threshold masks that are stored per vial */
+
+/* Appends the runs of the non-zero pixels of a binary image inside the vial spans */
+void   extractRuns(const cv::Mat& thresh, const Vial& vial, Runs& runs);
+/* Sets the pixels of the runs to 255 in the passed 8-bit image */
+void   drawRuns(const Runs& runs, cv::Mat& mask);
+/* Dense binary image of the runs of all vials */
+cv::Mat renderMask(const Vials& vials, const cv::Size& size);
+/* Pixel coordinates of the runs as a CV_32FC2 column in row-major order, like cv::findNonZero */
+void   runsToPoints(const Runs& runs, cv::Mat& points);
+int    countPixels(const Runs& runs);
+
+/* Serializes the runs of all vials into the .rle archive format, see tools/readlog.py for a reader */
+std::vector<uchar> encodeMask(const Vials& vials, const cv::Size& size);
+
+#endif // SPARSEMASK_H
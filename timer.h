@@ -18,6 +18,12 @@ int convertToInt(const T& time)
     return std::chrono::duration_cast<Seconds>(time).count();
 }
 
+template <typename T>
+double convertToSeconds(const T& time)
+{
+    return std::chrono::duration_cast<std::chrono::duration<double>>(time).count();
+}
+
 template <typename T>
 std::string timeToString(T&& time)
 {
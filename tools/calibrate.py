@@ -0,0 +1,78 @@
+import numpy as np
+import cv2
+import os
+from sys import argv, exit
+
+# Lens calibration for the fly counter, see lenscorrection.h.
+# Takes photos of a printed chessboard in different positions and angles, with --perspective the first photo
+# has to show the board lying flat on the rack with its rows along the vial rows. The perspective then maps
+# the board to an upright square grid so that a fly covers the same number of pixels everywhere on the rack.
+
+def find_corners(path, pattern):
+    gray = cv2.imread(path, cv2.IMREAD_GRAYSCALE)
+    if gray is None:
+        return None, None
+    found, corners = cv2.findChessboardCorners(gray, pattern)
+    if not found:
+        return gray.shape[::-1], None
+    criteria = (cv2.TERM_CRITERIA_EPS + cv2.TERM_CRITERIA_MAX_ITER, 30, 0.01)
+    corners = cv2.cornerSubPix(gray, corners, (11, 11), (-1, -1), criteria)
+    return gray.shape[::-1], corners
+
+def rack_perspective(corners, pattern, camera, distortion):
+    """homography of the undistorted image that turns the board into an axis aligned grid of the same mean pitch"""
+    undistorted = cv2.undistortPoints(corners, camera, distortion, P=camera).reshape(-1, 2)
+    grid = np.mgrid[0:pattern[0], 0:pattern[1]].T.reshape(-1, 2).astype(np.float32)
+    rows = undistorted.reshape(pattern[1], pattern[0], 2)
+    pitch = np.mean(np.linalg.norm(np.diff(rows, axis=1), axis=2))
+    # the corners may be ordered from any board corner, keep the image upright
+    direction = np.sign([np.diff(rows, axis=1)[..., 0].mean(), np.diff(rows, axis=0)[..., 1].mean()])
+    target = (grid - grid.mean(0)) * direction * pitch + undistorted.mean(0)
+    homography, _ = cv2.findHomography(undistorted, target)
+    return homography
+
+if __name__ == "__main__":
+    if len(argv) < 5:
+        print("Usage: python", argv[0], "image_dir inner_columns inner_rows output.yml [--perspective]")
+        exit(-1)
+    folder = argv[1]
+    pattern = (int(argv[2]), int(argv[3]))
+    output = argv[4]
+    perspective = "--perspective" in argv[5:]
+
+    board = np.zeros((pattern[0] * pattern[1], 3), np.float32)
+    board[:, :2] = np.mgrid[0:pattern[0], 0:pattern[1]].T.reshape(-1, 2)
+
+    size = None
+    objects = []
+    images = []
+    for file in sorted(os.listdir(folder)):
+        shape, corners = find_corners(os.path.join(folder, file), pattern)
+        if shape is None:
+            continue
+        if size is not None and shape != size:
+            print(file, "has another size, skipped")
+            continue
+        size = shape
+        if corners is None:
+            print(file, "no board found")
+            continue
+        print(file, "ok")
+        objects.append(board)
+        images.append(corners)
+
+    if len(images) < 3:
+        print("Need at least three photos with a detected board")
+        exit(-1)
+
+    error, camera, distortion, _, _ = cv2.calibrateCamera(objects, images, size, None, None)
+    print("reprojection error", error, "px")
+
+    storage = cv2.FileStorage(output, cv2.FILE_STORAGE_WRITE)
+    storage.write("image_width", size[0])
+    storage.write("image_height", size[1])
+    storage.write("camera_matrix", camera)
+    storage.write("distortion_coefficients", distortion)
+    if perspective:
+        storage.write("perspective", rack_perspective(images[0], pattern, camera, distortion))
+    storage.release()
@@ -0,0 +1,29 @@
+import json
+from sys import argv, exit
+
+# compares two JSON result files of the flyBenchmark executable, e.g. before and after a change
+
+def load(path):
+    with open(path) as f:
+        return dict((b["name"], b) for b in json.load(f)["benchmarks"])
+
+if __name__ == "__main__":
+    if len(argv) < 3:
+        print("Usage: python", argv[0], "baseline.json contender.json [tolerance]")
+        exit(-1)
+    baseline = load(argv[1])
+    contender = load(argv[2])
+    tolerance = float(argv[3]) if len(argv) > 3 else 0.05
+
+    regressions = 0
+    for name, new in contender.items():
+        if name not in baseline:
+            continue
+        old = baseline[name]
+        change = new["real_time"] / old["real_time"] - 1.0
+        marker = ""
+        if change > tolerance:
+            marker = "  <-- slower"
+            regressions += 1
+        print("%-56s %14.0f ns %14.0f ns %+7.1f%%%s" % (name, old["real_time"], new["real_time"], 100.0 * change, marker))
+    exit(1 if regressions else 0)
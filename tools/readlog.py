@@ -0,0 +1,55 @@
+import numpy as np
+import os
+from sys import argv, exit
+
+# record layouts of the binary experiment log, see experimentlog.h
+HEADER = 16
+ROUND = np.dtype([("time", "<f8"), ("round", "<u4"), ("vials", "<u4"), ("pixelsPerFly", "<f4"), ("flies", "<u4")])
+VIAL = np.dtype([("round", "<u4"), ("vial", "<u2"), ("clusters", "<u2"), ("flies", "<i4"), ("noise", "<i4"), ("x", "<f4"), ("y", "<f4")])
+CLUSTER = np.dtype([("round", "<u4"), ("vial", "<u2"), ("reserved", "<u2"), ("label", "<i4"), ("size", "<u4"), ("x", "<f4"), ("y", "<f4")])
+
+def load(path, dtype, magic):
+    with open(path, "rb") as f:
+        header = f.read(HEADER)
+    if header[:8] != magic:
+        raise ValueError(path + " is not a fly detector log")
+    if np.frombuffer(header[12:16], "<u4")[0] != dtype.itemsize:
+        raise ValueError(path + " has an unexpected record size")
+    count = (os.path.getsize(path) - HEADER) // dtype.itemsize
+    return np.memmap(path, dtype=dtype, mode="r", offset=HEADER, shape=(count,))
+
+def open_log(directory):
+    rounds = load(os.path.join(directory, "rounds.bin"), ROUND, b"FLYROUND")
+    vials = load(os.path.join(directory, "vials.bin"), VIAL, b"FLYVIALS")
+    clusters = load(os.path.join(directory, "clusters.bin"), CLUSTER, b"FLYCLUST")
+    return rounds, vials, clusters
+
+def read_mask(path):
+    """decodes a run-length threshold mask archived in the threshold mask mode into a boolean image"""
+    with open(path, "rb") as f:
+        data = f.read()
+    if data[:8] != b"FLYMASK1":
+        raise ValueError(path + " is not a fly detector mask")
+    width, height, count = np.frombuffer(data[8:20], "<u4")
+    runs = np.frombuffer(data[20:20 + 6 * count], "<u2").reshape(-1, 3)
+    mask = np.zeros((height, width), dtype=bool)
+    for row, begin, end in runs:
+        mask[row, begin:end] = True
+    return mask
+
+def recount(rounds, clusters, pixelsPerFly):
+    """re-derives the rounds x vials fly counts for another pixelsPerFly from the stored cluster sizes"""
+    counts = np.zeros((rounds.shape[0], rounds["vials"].max() if rounds.shape[0] else 0), dtype=np.int32)
+    flies = np.ceil(clusters["size"] / float(pixelsPerFly)).astype(np.int32)
+    np.add.at(counts, (clusters["round"], clusters["vial"]), flies)
+    return counts
+
+if __name__ == "__main__":
+    if len(argv) < 2:
+        print("Usage: python", argv[0], "experiment_dir [pixelsPerFly]")
+        exit(-1)
+    rounds, vials, clusters = open_log(argv[1])
+    print("Rounds:", rounds.shape[0], "Vials:", vials.shape[0], "Clusters:", clusters.shape[0])
+    if len(argv) > 2:
+        for r, counts in zip(rounds, recount(rounds, clusters, int(argv[2]))):
+            print("%.3f" % r["time"], "\t".join(str(c) for c in counts))
@@ -1,5 +1,5 @@
-import h5py as h5
 import numpy as np
+from FlyDetector import DatasetWriter, cropVials
 import cv2
 from PIL import Image
 import os
@@ -19,11 +19,8 @@ crop = 200
 images = []
 
   
-out = h5.File(outputfile,"a")
-if (not "data" in out):
-    data = out.create_dataset('data', (0,3,vial_h, vial_w), maxshape=(None,3,vial_h, vial_w),dtype='u1')
-    label = out.create_dataset('label', (0,1), maxshape=(None,1),dtype='u1')
-out.close()
+# creates the data/label datasets or appends to them, the crops are written in the background
+out = DatasetWriter(outputfile, vial_h, vial_w)
 
 for subdir, dirs, files in os.walk(inputfolder):
     for file in files:
@@ -32,29 +29,31 @@ for subdir, dirs, files in os.walk(inputfolder):
 for image in images:
     print(image)
     img = cv2.imread(image)
-    img = cv2.copyMakeBorder(img,vial_h,vial_h,vial_w,vial_w,cv2.BORDER_CONSTANT,value=[0,255,0])
-    h = img.shape[0]
-    w = img.shape[1]
-    
-    #find vials
+
+    #find vials, same detection as for the existing datasets so that new crops are cut alike
     hsv = cv2.cvtColor(img, cv2.COLOR_RGB2HSV)
     mask = cv2.inRange(hsv, np.array([0,150,0]), np.array([255,255,255]))
-    contours = cv2.findContours(mask, cv2.RETR_LIST,cv2.CHAIN_APPROX_NONE)
+    # a 1 px greenscreen border closes the vials at the image edge like the former padding of the whole image
+    mask = cv2.copyMakeBorder(mask,1,1,1,1,cv2.BORDER_CONSTANT,value=255)
+    contours = cv2.findContours(mask, cv2.RETR_LIST,cv2.CHAIN_APPROX_NONE,offset=(-1,-1))
 
-    vials = []
     vialSize = np.pi * 150**2 
 
     min = vialSize * 0.6
     max = vialSize * 1.4
 
+    centers = []
     for c in contours[0]:
-	    area =  cv2.contourArea(c) 
-	    if area > min and area < max:
-		    vials.append(c)
-    
-    for v in vials:
-        center = v.mean(0).squeeze().astype(np.int)
-        vial = img[center[1]-vial_h/2:center[1]+vial_h/2,center[0]-vial_w/2:center[0]+vial_w/2]
+        area =  cv2.contourArea(c) 
+        if area > min and area < max:
+            centers.append(c.mean(0).squeeze().astype(np.int32))
+    if not centers:
+        continue
+
+    # the crops are cut in parallel and only their parts outside of the image are padded
+    crops = cropVials(img, np.array(centers, dtype=np.int32), vial_h, vial_w)
+
+    for vial in crops:
         Image.fromarray(vial).show()
         skipImage = False
         skipVial = False
@@ -62,6 +61,7 @@ for image in images:
             try:
                 s = raw_input("How many flies can you see? (x->skip vial; X->skip image; exit->exit)")
                 if s=="exit":
+                    out.close()
                     exit(0)  
                 elif s=="x":
                     skipVial = True
@@ -78,16 +78,6 @@ for image in images:
             continue
         if skipImage:
             break
-        vial = np.rollaxis(vial,2)
-        out = h5.File(outputfile,"a")
-        data = out["data"]
-        label = out["label"]
-        idx = data.shape[0]
-        new_data_shape = (idx+1,) + data.shape[1:]
-        new_label_shape = (idx+1,) + label.shape[1:]
-        data.resize(new_data_shape)
-        label.resize(new_label_shape)
-        data[idx] = vial
-        label[idx]=int(flies)
-        out.close()           
+        out.append(vial, int(flies))
 
+out.close()
@@ -0,0 +1,160 @@
+#include "tracer.h"
+
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+struct TraceEvent
+{
+    const char* name;
+    long long   begin;    // ns since the trace start
+    long long   duration; // ns
+};
+
+/* events of one thread, written only by the owning thread */
+struct ThreadTrace
+{
+    int                     id;
+    const char*             name;
+    bool                    owned;  // a running thread records into it
+    std::vector<TraceEvent> events; // allocated on the first event
+    std::atomic<size_t>     written;
+
+    ThreadTrace(int number) : id(number), name(nullptr), owned(true), written(0) {}
+};
+
+/* hands the trace of an exiting thread back for reuse */
+struct TraceOwner
+{
+    ThreadTrace* trace;
+    const char*  name; // kept while the thread has no trace yet
+
+    TraceOwner() : trace(nullptr), name(nullptr) {}
+    ~TraceOwner();
+};
+
+std::atomic<bool> Tracer::enabled(false);
+
+/* the traces of finished threads are kept until they were written, afterwards new threads reuse them */
+static std::mutex                                traceLock;
+static std::vector<std::unique_ptr<ThreadTrace>> traces;
+static std::vector<ThreadTrace*>                 idle;
+static Timepoint                                 origin;
+static thread_local TraceOwner                   local;
+
+TraceOwner::~TraceOwner()
+{
+    if (this->trace == nullptr) return;
+
+    std::lock_guard<std::mutex> guard(traceLock);
+    this->trace->owned = false;
+    if (!Tracer::isEnabled())
+    {
+        idle.push_back(this->trace);
+    }
+}
+
+static ThreadTrace* threadTrace()
+{
+    if (local.trace == nullptr)
+    {
+        std::lock_guard<std::mutex> guard(traceLock);
+        if (idle.empty())
+        {
+            traces.emplace_back(new ThreadTrace((int)traces.size() + 1));
+            local.trace = traces.back().get();
+        }
+        else
+        {
+            local.trace = idle.back();
+            idle.pop_back();
+            local.trace->owned = true;
+            local.trace->written.store(0, std::memory_order_relaxed);
+        }
+        local.trace->name = local.name;
+    }
+    return local.trace;
+}
+
+static long long nanoseconds(const Clock::duration& duration)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+}
+
+void Tracer::start()
+{
+    std::lock_guard<std::mutex> guard(traceLock);
+    for (auto& trace : traces)
+    {
+        trace->written.store(0, std::memory_order_relaxed);
+        if (!trace->owned) trace->name = nullptr; // idle, no thread to list
+    }
+    origin = Clock::now();
+    Tracer::enabled.store(true, std::memory_order_release);
+}
+
+void Tracer::complete(const char* name, const Timepoint& begin, const Timepoint& end)
+{
+    ThreadTrace* trace = threadTrace();
+    if (trace->events.empty())
+    {
+        trace->events.resize(CAPACITY);
+    }
+
+    size_t index = trace->written.load(std::memory_order_relaxed);
+    TraceEvent& event = trace->events[index % CAPACITY];
+    event.name     = name;
+    event.begin    = nanoseconds(begin - origin);
+    event.duration = nanoseconds(end - begin);
+    trace->written.store(index + 1, std::memory_order_release);
+}
+
+/* only remembered until the thread records its first event, threads that never do cost nothing */
+void Tracer::setThreadName(const char* name)
+{
+    local.name = name;
+    if (local.trace != nullptr)
+    {
+        local.trace->name = name;
+    }
+}
+
+bool Tracer::stop(const std::string& path)
+{
+    std::lock_guard<std::mutex> guard(traceLock);
+    Tracer::enabled.store(false, std::memory_order_release);
+
+    // the traces of the threads that finished while tracing are free once this returns
+    idle.clear();
+    for (auto& trace : traces)
+    {
+        if (!trace->owned) idle.push_back(trace.get());
+    }
+
+    FILE* file = std::fopen(path.c_str(), "w");
+    if (file == nullptr) return false;
+
+    std::fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+    bool first = true;
+    for (auto& trace : traces)
+    {
+        if (trace->name != nullptr)
+        {
+            std::fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}", first ? "" : ",\n", trace->id, trace->name);
+            first = false;
+        }
+
+        size_t written = trace->written.load(std::memory_order_acquire);
+        size_t begin   = written > CAPACITY ? written - CAPACITY : 0;
+        for (size_t i = begin; i < written; ++i)
+        {
+            const TraceEvent& event = trace->events[i % CAPACITY];
+            std::fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}", first ? "" : ",\n", event.name, trace->id, event.begin / 1000.0, event.duration / 1000.0);
+            first = false;
+        }
+    }
+    std::fprintf(file, "\n]}\n");
+    return std::fclose(file) == 0;
+}
@@ -0,0 +1,56 @@
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <atomic>
+#include <string>
+
+#include "timer.h"
+
+/* Opt-in execution trace of all threads in the Chrome trace event format, open with chrome://tracing or Perfetto */
+/* Every thread records into its own ring buffer without locks, the oldest events are overwritten when it is full */
+class Tracer
+{
+private:
+    static std::atomic<bool> enabled;
+
+public:
+    static const size_t CAPACITY = 1 << 16; // events per thread
+
+    static void start();
+    /* Stops recording and writes the buffered events of all threads as JSON */
+    static bool stop(const std::string& path);
+
+    static bool isEnabled()
+    {
+        return Tracer::enabled.load(std::memory_order_relaxed);
+    }
+
+    /* Records a finished span of the calling thread, the name must be a literal */
+    static void complete(const char* name, const Timepoint& begin, const Timepoint& end);
+    /* Names the calling thread in the trace, the name must be a literal */
+    static void setThreadName(const char* name);
+};
+
+/* Traces the lifetime of the object, costs a single relaxed load if tracing is disabled */
+class TraceScope
+{
+private:
+    const char* name;
+    bool        active;
+    Timepoint   begin;
+
+    TraceScope(const TraceScope&);
+    TraceScope& operator=(const TraceScope&);
+
+public:
+    explicit TraceScope(const char* span) : name(span), active(Tracer::isEnabled())
+    {
+        if (this->active) this->begin = Clock::now();
+    }
+    ~TraceScope()
+    {
+        if (this->active) Tracer::complete(this->name, this->begin, Clock::now());
+    }
+};
+
+#endif // TRACER_H
@@ -10,6 +10,39 @@ unsigned char USBShaker::OFF[] = {0xFD, 0x01};
 
 /** private **/
 
+/* the index-th connected relay in bus order */
+libusb_device_handle* USBShaker::openDevice(int index)
+{
+    if (index == 0)
+    {
+        return libusb_open_device_with_vid_pid(nullptr, VID, PID);
+    }
+
+    libusb_device** devices;
+    long count = libusb_get_device_list(nullptr, &devices);
+    libusb_device_handle* handle = nullptr;
+
+    for (long i = 0; i < count; ++i)
+    {
+        libusb_device_descriptor descriptor;
+        if (libusb_get_device_descriptor(devices[i], &descriptor) != 0) continue;
+        if (descriptor.idVendor != VID || descriptor.idProduct != PID) continue;
+        if (index-- > 0) continue;
+
+        if (libusb_open(devices[i], &handle) != 0)
+        {
+            handle = nullptr;
+        }
+        break;
+    }
+    if (count >= 0)
+    {
+        libusb_free_device_list(devices, 1);
+    }
+
+    return handle;
+}
+
 void USBShaker::shake()
 {
     // start shaking, wait till end is reached, stop shaking
@@ -55,7 +88,8 @@ void USBShaker::stop()
 
 /** public **/
 
-USBShaker::USBShaker()
+USBShaker::USBShaker(int index)
+  : device(nullptr)
 {
     // initialize libusb
     int error = libusb_init(nullptr);
@@ -66,7 +100,7 @@ USBShaker::USBShaker()
     }
 
     // retrieve the device by vendor and product ID (fixed for USB relays)
-    this->device = libusb_open_device_with_vid_pid(nullptr, VID, PID);
+    this->device = this->openDevice(index);
     if (this->device == nullptr)
     {
         return;
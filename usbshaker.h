@@ -29,12 +29,14 @@ protected:
     /* USB device */
     libusb_device_handle* device;
 
+    libusb_device_handle* openDevice(int index);
     void shake();
     void start();
     void stop();
 
 public:
-    USBShaker();
+    /* the index selects one of several connected relays, e.g. one per rack */
+    USBShaker(int index=0);
 
     virtual bool isAccessable();
     virtual void shakeFor(const Duration& shakeTime);
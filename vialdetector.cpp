@@ -0,0 +1,13 @@
+#include "vialdetector.h"
+
+#include "greenscreendetector.h"
+#include "houghdetector.h"
+
+VialDetector* createVialDetector(int mode)
+{
+    switch (mode)
+    {
+        case HOUGH_CIRCLES: return new HoughDetector();
+        default:            return new GreenScreenDetector();
+    }
+}
@@ -0,0 +1,36 @@
+#ifndef VIALDETECTOR_H
+#define VIALDETECTOR_H
+
+#include <opencv2/opencv.hpp>
+
+#include "racklayout.h"
+#include "vials.h"
+
+/* selectable vial detectors */
+enum VialDetection
+{
+    GREEN_SCREEN  = 0,
+    HOUGH_CIRCLES = 1
+};
+
+/* Abstract vial detector interface */
+class VialDetector
+{
+protected:
+    RackLayout layout; // of the last detection, keeps the vial ids of the next one if outer rows or columns are missing
+
+public:
+    /* Vials of about the given radius in px in an RGB image, named and sorted by their rack position */
+    virtual Vials detect(const cv::Mat& image, int vialSize) = 0;
+    /* forgets the last layout, e.g. when the rack may have been moved */
+    void reset()
+    {
+        this->layout = RackLayout();
+    }
+    virtual ~VialDetector() {}
+};
+
+/* Detector of the passed mode, the green screen one for unknown modes */
+VialDetector* createVialDetector(int mode);
+
+#endif // VIALDETECTOR_H
@@ -2,6 +2,7 @@
 #include <cmath>
 #include <string>
 
+#include "racklayout.h"
 #include "vials.h"
 
 static const cv::Scalar VIAL_COLOR  = cv::Scalar(0, 0, 255);
@@ -10,15 +11,15 @@ static const int        FONT        = CV_FONT_HERSHEY_SIMPLEX;
 static const int        FONT_SCALE  = 1;
 static const int        FONT_STROKE = 4;
 
+/* row by row order of the rack grid, see fitRackLayout */
 bool compareVials(const Vial& first, const Vial& second)
 {
-    int threshold = first.radius;
-    if (std::abs(first.center.y - second.center.y) < threshold)
+    if (first.row != second.row)
     {
-        return first.center.x < second.center.x;
+        return first.row < second.row;
     }
 
-    return first.center.y < second.center.y;
+    return first.column < second.column;
 }
 
 cv::Mat drawVials(const Vials& vials, const cv::Mat& image)
@@ -26,15 +27,12 @@ cv::Mat drawVials(const Vials& vials, const cv::Mat& image)
     if (image.empty())
         return image;
     int baseline;
-    int counter = 0;
     cv::Mat vialImage = image.clone();
-    char rows[4] = {'A','B','C','D'};
 
-    for (Vial vial : vials)
+    for (const Vial& vial : vials)
     {
-        std::stringstream vialNumber;
-        vialNumber << rows[counter/5]<< std::to_string(counter % 5 + 1);
-        cv::Size fontSize = cv::getTextSize(vialNumber.str(), FONT, FONT_SCALE, FONT_STROKE, &baseline);
+        const std::string vialNumber = vialName(vial.row, vial.column);
+        cv::Size fontSize = cv::getTextSize(vialNumber, FONT, FONT_SCALE, FONT_STROKE, &baseline);
 
         std::stringstream flies;
         flies <<  vial.flyCount;
@@ -43,15 +41,14 @@ cv::Mat drawVials(const Vials& vials, const cv::Mat& image)
         cv::Point center = vial.center;
         center.x -= fontSize.width/2,
         center.y += fontSize.height/2;
-        cv::putText(vialImage, vialNumber.str(), center, FONT, FONT_SCALE, VIAL_COLOR, FONT_STROKE);
+        cv::putText(vialImage, vialNumber, center, FONT, FONT_SCALE, VIAL_COLOR, FONT_STROKE);
         cv::putText(vialImage, flies.str(), center + cv::Point( vial.radius + fontSize.width, 0), FONT, FONT_SCALE, VIAL_COLOR, FONT_STROKE);
-        ++counter;
     }
 
     return vialImage;
 }
 
-Vials findVials(const cv::Mat& image, int vialSize)
+Vials findVials(const cv::Mat& image, int vialSize, RackLayout* layout)
 {
     // Greenscreen image
     Vials vials;
@@ -80,7 +77,7 @@ Vials findVials(const cv::Mat& image, int vialSize)
         {
             // Shift contours to center due perpective distortion
             float shift = 0.002;
-            cv::Point center(image.size[0]/2,image.size[1]/2);
+            cv::Point center(image.cols/2, image.rows/2);
             for (unsigned int j = 0; j < contours[i].size(); j++)
             {
                 cv::Point distance = center - contours[i][j];
@@ -90,8 +87,27 @@ Vials findVials(const cv::Mat& image, int vialSize)
         }
     }
 
-    // Sort vials
-    std::sort(vials.begin(), vials.end(), compareVials);
+    // Name and sort vials by their rack position
+    RackLayout fitted = fitRackLayout(vials, layout);
+    if (layout != nullptr)
+    {
+        *layout = fitted;
+    }
 
     return vials;
 }
+
+Vial circularVial(const cv::Size& size, int vialSize)
+{
+    const cv::Point center(size.width / 2, size.height / 2);
+    const int radius = std::min(vialSize, std::min(size.width, size.height) / 2);
+
+    return circularVial(center, radius);
+}
+
+Vial circularVial(const cv::Point& center, int radius)
+{
+    std::vector<cv::Point> contour;
+    cv::ellipse2Poly(center, cv::Size(radius, radius), 0, 0, 360, 1, contour);
+    return Vial(contour);
+}
@@ -1,32 +1,45 @@
 #ifndef VIALS_H
 #define VIALS_H
 
+#include <climits>
 #include <vector>
 #include <math.h>
 #include "dbscan/constants.h"
+#include "dbscan/rundbscan.h"
 
 #include <opencv2/opencv.hpp>
 
 typedef cv::Vec3b          Color;
+typedef cv::Vec2i          Span; // [begin, end) columns of one vial row
 
 struct Vial
 {
     std::vector<cv::Point> pts;
     cv::Point center;
+    int row;    // position in the rack grid, -1 until a layout is fitted
+    int column;
     int area;
     int radius;
+    cv::Rect bounds;
+    std::vector<Span> spans; // one per row of bounds
     int flyCount;
+    Runs runs; // foreground of the threshold stage, sorted by row and column
     cv::Mat flyPixels;
     std::vector<Cluster> labels;
     std::map<int, int> clusterSizes;
+    std::map<int, cv::Point2f> clusterCenters;
     Vial():
         center(cv::Point(0,0)),
+        row(-1),
+        column(-1),
         flyCount(0)
     {}
     Vial(const std::vector<cv::Point>& points)
         :
         pts(points),
         center(cv::Point(0,0)),
+        row(-1),
+        column(-1),
         flyCount(0)
     {
         // Compute mean and radius
@@ -37,16 +50,49 @@ struct Vial
         area = cv::contourArea(pts);
 
         radius = sqrt(area/M_PI);
+        computeSpans();
     }
-};
 
+    /* relative climbing height of an image position, 0 at the lower and 1 at the upper vial edge */
+    float height(const cv::Point2f& position) const
+    {
+        if (bounds.height == 0) return 0.0f;
+        return (bounds.y + bounds.height - position.y) / (float)bounds.height;
+    }
+
+    /* row-wise extent of the vial interior, the vials are convex so each row is a single span */
+    void computeSpans()
+    {
+        bounds = cv::boundingRect(pts);
+        cv::Mat mask = cv::Mat::zeros(bounds.height, bounds.width, CV_8UC1);
+        cv::drawContours(mask, std::vector<std::vector<cv::Point>>(1, pts), 0, cv::Scalar(255), -1, 8, cv::noArray(), INT_MAX, cv::Point(-bounds.x, -bounds.y));
+
+        spans.assign(bounds.height, Span(0, 0));
+        for (int y = 0; y < mask.rows; ++y)
+        {
+            const uchar* row = mask.ptr<uchar>(y);
+            int begin = 0;
+            int end   = mask.cols;
+            while (begin < end && !row[begin])   ++begin;
+            while (end > begin && !row[end - 1]) --end;
+            spans[y] = Span(bounds.x + begin, bounds.x + end);
+        }
+    }
+};
 
 typedef std::vector<Vial> Vials;
 
+struct RackLayout;
+
 static const int VIAL_TOLERANCE = 20; //px
 
 bool    compareVials(const Vial& first, const Vial& second);
 cv::Mat drawVials(const Vials& vials, const cv::Mat& image);
-Vials   findVials(const cv::Mat& image, int vialSize);
+/* the layout, if passed, anchors the vial ids to the one of the previous frame and is replaced by the new one */
+Vials   findVials(const cv::Mat& image, int vialSize, RackLayout* layout=nullptr);
+/* a circular vial of the given radius centered in an image of the given size, the template for pre-cropped vial images */
+Vial    circularVial(const cv::Size& size, int vialSize);
+/* a circular vial of the given radius around the center */
+Vial    circularVial(const cv::Point& center, int radius);
 
 #endif // VIALS_H
@@ -1,7 +1,7 @@
 #include "webcamera.h"
 
-WebCamera::WebCamera()
-  : cam(0)
+WebCamera::WebCamera(int index)
+  : cam(index)
 {
     try
     {
@@ -13,7 +13,7 @@ public:
     static const int IMAGE_WIDTH   = 1080;
     static const int IMAGE_HEIGHT  =  720;
 
-    WebCamera();
+    WebCamera(int index=0);
     virtual bool getImage(cv::Mat& mat);
     virtual ~WebCamera();
 };